@@ -90,6 +90,11 @@
 ///	to indicate to the serial device at the other end that
 ///	the local serial buffer is nearly full.
 ///
+/// GOLAY_COMPACT		[optional]
+///	Use the 1.4k compact golay tables in place of the 12k full
+///	ones. Decoding a word with errors in its data bits is slower.
+///	For boards short of flash.
+///
 
 #ifndef _BOARD_H_
 #define _BOARD_H_
@@ -118,4 +123,30 @@
 # error Must define a BOARD_ value before including this file.
 #endif
 
+// golay 23/12 FEC, selected at runtime with PARAM_ECC. Its tables take
+// 12k of flash, which the Si1030 boards keep in bank 1 so they fit
+// alongside the AES code
+#define INCLUDE_GOLAY
+
+// shortened Reed-Solomon FEC, PARAM_ECC 3, for links where golay's rate
+// 1/2 costs too much airtime. The Si1000 boards have no flash banks to
+// spare, so it is only for the Si1030 boards
+#ifdef CPU_SI1030
+#define INCLUDE_RS
+#endif
+
+// XOR parity packets across groups of data packets, PARAM_PARITY_GROUP.
+// They need two more packet buffers of xdata, which only the Si1030
+// boards have room for
+#ifdef CPU_SI1030
+#define INCLUDE_ERASURE
+#endif
+
+// bit majority voting between three damaged copies of a packet, for
+// golay and Reed-Solomon packets. It needs three packet buffers of
+// xdata, so it is also only for the Si1030 boards
+#ifdef CPU_SI1030
+#define INCLUDE_COMBINE
+#endif
+
 #endif // _BOARD_H_
@@ -40,6 +40,11 @@ endif
 #
 include $(SRCROOT)/include/rules_$(BOARD).mk
 
+# space at the top of bank 1 kept out of the bank allocation. The
+# final check of the image doesn't use it, as what fills that space is
+# part of the image
+CODE_OFFSET_BANK1	?= 0x00
+
 HB=$(if $(filter $(HAVE_BANKING),1),1,0)
 BS=$(if $(filter $(PRODUCT_SUPPORT_BANKING),1),1,0)
 MODEL_HUGE=$(if $(filter $(HB),1),$(BS),0)
@@ -121,7 +126,7 @@ $(PRODUCT_HEX):	$(OBJS)
 	@mkdir -p $(dir $@)
 ifeq ($(MODEL_HUGE), 1)
 	$(v)$(LD) -Wl-r $(LDFLAGS) -o $@ $(OBJS)
-	$(v)$(BANK_ALLOC) $(OBJROOT)/$(PRODUCT) $(PRODUCT_DIR)/segment.rules $(CODE_OFFSET_HOME) 0x00 0x00 $(CODE_OFFSET_BANK3)
+	$(v)$(BANK_ALLOC) $(OBJROOT)/$(PRODUCT) $(PRODUCT_DIR)/segment.rules $(CODE_OFFSET_HOME) $(CODE_OFFSET_BANK1) 0x00 $(CODE_OFFSET_BANK3)
 	@rm $@
 	$(v)$(LD) -o $@ -Wl-r $(LDFLAGS) `cat $(OBJROOT)/$(PRODUCT).flags` $(OBJS)
 else
@@ -39,5 +39,9 @@ CODE_OFFSET_HOME		 = 0x400
 CODE_OFFSET_BANK3		 = 0x800
 #--model-huge
 LDFLAGS				+= --model-large --out-fmt-ihx --iram-size 256 --xram-size $(XRAM_SIZE) --code-loc $(CODE_OFFSET_HOME) --code-size 0xF400 --stack-size 64
+# golay tables go in the top 12k of flash bank 1, see radio/golay23.h.
+# The bank allocator is told to leave that space free
+CODE_OFFSET_BANK1		 = 0x3000
+LDFLAGS				+= -Wl-bGOLAYSEG=0x1D000
 BOOTLDFLAGS			 = --iram-size 256 --xram-size $(XRAM_SIZE) --stack-size 64 --nostdlib -Wl-r -Wl-bHIGHCSEG=0x0FC00
 # --code-size 0x1F400
\ No newline at end of file
@@ -342,6 +342,152 @@ CBC_ENCRYPT_DECRYPT_STATUS
 
    return SUCCESS;
 }
+//-----------------------------------------------------------------------------
+// CBC_EncryptInPlace()
+//
+// parameters:
+//    operation       - encryption & 128/192/256 options
+//    buffer          - xdata pointer to plainText, replaced by cipherText
+//    key             - xdata pointer to encryption key
+//
+// returns:
+//    status         - 0 for success
+//                   - 1 for ERROR - Invalid operation parameter.
+//
+// description:
+//
+// This function performs Cipher Block Chaining (CBC) Mode Encryption of a
+// specified number of 16-byte blocks, in place, in one DMA transfer.
+//
+// The initial vector must be in the 16 bytes of xdata immediately before
+// the buffer. The AES0XIN channel then reads the initial vector for the
+// first block and the previous ciphertext block for each following block
+// from one contiguous region, so no second transfer is needed.
+//
+// Only encryption operations are valid, as decryption cannot be done in
+// place.
+//
+//-----------------------------------------------------------------------------
+CBC_ENCRYPT_DECRYPT_STATUS
+   CBC_EncryptInPlace (CBC_ENCRYPT_DECRYPT_OPERATION operation,
+   VARIABLE_SEGMENT_POINTER(buffer, U8, SEG_XDATA),
+   VARIABLE_SEGMENT_POINTER(key, U8, SEG_XDATA),
+   U16 blocks)
+{
+   // Unions used for compiler independent endianness.
+   UU16 length;                        // Length in bytes for all blocks.
+   UU16 addr;                          // Union used to access pointer bytes.
+
+   U8 keyLength;                       // Used to calculate key length in bytes.
+
+   // check first for valid operation
+   if((operation < ENCRYPTION_128_BITS)||(operation >= ENCRYPTION_UNDEFINED))
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+   else
+   {
+      // Calculate key length in bytes based on operation parameter.
+      keyLength = (((operation & 0x03) + 2) << 3);
+   }
+
+   // Calculate plaintext and ciphertext total length.
+   length.U16 = (blocks << 4);
+
+   SFRPAGE = DPPE_PAGE;
+
+   AES0BCFG = 0x00;                      // disable for now
+   AES0DCFG = 0x00;                      // disable for now
+
+   // Disable AES0KIN, AES0BIN, AES0XIN, & AES0YOUT channels.
+   DMA0EN &= ~AES0_KBXY_MASK;
+
+   // Configure AES key input channel using key pointer.
+   // Set DMA0NMD to enable key wrapping, so the key is
+   // reloaded for every block.
+   DMA0SEL = AES0KIN_CHANNEL;
+   DMA0NCF = AES0KIN_PERIPHERAL_REQUEST;
+   DMA0NMD = WRAPPING;
+   addr.U16 = (U16)(key);
+   DMA0NBAL = addr.U8[LSB];
+   DMA0NBAH = addr.U8[MSB];
+   DMA0NSZH = 0;
+   DMA0NSZL = keyLength;
+   DMA0NAOL = 0;
+   DMA0NAOH = 0;
+
+   // AES block input is the plaintext, for all blocks.
+   addr.U16 = (U16)(buffer);
+   DMA0SEL = AES0BIN_CHANNEL;
+   DMA0NCF = AES0BIN_PERIPHERAL_REQUEST;
+   DMA0NMD = NO_WRAPPING;
+   DMA0NBAL = addr.U8[LSB];
+   DMA0NBAH = addr.U8[MSB];
+   DMA0NSZL = length.U8[LSB];
+   DMA0NSZH = length.U8[MSB];
+   DMA0NAOL = 0;
+   DMA0NAOH = 0;
+
+   // AES Y output is the ciphertext, over the plaintext.
+   DMA0SEL = AES0YOUT_CHANNEL;
+   DMA0NCF = AES0YOUT_PERIPHERAL_REQUEST|DMA_INT_EN;
+   DMA0NMD = NO_WRAPPING;
+   DMA0NBAL = addr.U8[LSB];
+   DMA0NBAH = addr.U8[MSB];
+   DMA0NSZL = length.U8[LSB];
+   DMA0NSZH = length.U8[MSB];
+   DMA0NAOH = 0;
+   DMA0NAOL = 0;
+
+   // AES X input starts at the initial vector, 16 bytes before the
+   // buffer, and then follows the ciphertext one block behind.
+   addr.U16 -= 16;
+   DMA0SEL = AES0XIN_CHANNEL;
+   DMA0NCF = AES0XIN_PERIPHERAL_REQUEST;
+   DMA0NMD = NO_WRAPPING;
+   DMA0NBAL = addr.U8[LSB];
+   DMA0NBAH = addr.U8[MSB];
+   DMA0NSZL = length.U8[LSB];
+   DMA0NSZH = length.U8[MSB];
+   DMA0NAOL = 0;
+   DMA0NAOH = 0;
+
+   // Clear KBXY (Key, Block, X in, and Y out) bits in DMA0INT sfr using mask.
+   DMA0INT &= ~AES0_KBXY_MASK;
+
+   // Set KBXY (Key, Block, Xin, and Y out) bits in DMA0EN sfr using mask.
+   DMA0EN  |=  AES0_KBXY_MASK;
+
+   // XOR on input - CBC Encryption
+   AES0DCFG = XOR_ON_INPUT;
+
+   // Configure AES0BCFG for encryption and enable the AES module.
+   AES0BCFG = operation;
+   AES0BCFG |= AES_ENABLE;
+
+   EIE2 |= 0x20;                 // enable DMA interrupt to terminate Idle mode
+
+   // This do...while loop ensures that the CPU will remain in Idle mode
+   // until AES0YOUT DMA channel transfer is complete.
+   do
+   {
+      #ifdef DMA_TRANSFERS_USE_IDLE
+      PCON |= 0x01;                    // go to Idle mode
+      #endif
+   }  while((DMA0INT & AES0YOUT_MASK)==0);
+
+   //Clear AES Block
+   AES0BCFG = 0x00;
+   AES0DCFG = 0x00;
+
+   // Clear KXBY (Key, Block, XOR, and Y out) bits in DMA0EN sfr using mask.
+   DMA0EN &= ~AES0_KBXY_MASK;
+
+   // Clear KBY (Key, Block, and Y out) bits in DMA0INT sfr using mask.
+   DMA0INT &= ~AES0_KBXY_MASK;
+
+   return SUCCESS;
+}
 //=============================================================================
 // End of file
 //=============================================================================
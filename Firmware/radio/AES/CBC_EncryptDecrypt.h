@@ -54,6 +54,12 @@ CBC_ENCRYPT_DECRYPT_STATUS
    VARIABLE_SEGMENT_POINTER(initialVector, U8, SEG_XDATA),
    VARIABLE_SEGMENT_POINTER(key, U8, SEG_XDATA),
    U16 blocks);
+
+CBC_ENCRYPT_DECRYPT_STATUS
+   CBC_EncryptInPlace (CBC_ENCRYPT_DECRYPT_OPERATION operation,
+   VARIABLE_SEGMENT_POINTER(buffer, U8, SEG_XDATA),
+   VARIABLE_SEGMENT_POINTER(key, U8, SEG_XDATA),
+   U16 blocks);
 //=============================================================================
 // End of file
 //=============================================================================
@@ -29,14 +29,13 @@
 
 #include <stdarg.h>
 #include "../radio.h"
+#include "../timer.h"
 #include "GenerateDecryptionKey.h"
 #include "AES_BlockCipher.h"
 #include "CBC_EncryptDecrypt.h"
 #include "CTR_EncryptDecrypt.h"
 #include <stdlib.h>
 
-#define MAX_ENCRYPT_PACKET_LENGTH 32
-
 /* SEGMENT_VARIABLE (EncryptionKey[32], U8, SEG_XDATA); */
 __xdata unsigned char *EncryptionKey;
 SEGMENT_VARIABLE (DecryptionKey[32], U8, SEG_XDATA);
@@ -48,14 +47,34 @@ SEGMENT_VARIABLE (Counter[16], U8, SEG_XDATA);
 const SEGMENT_VARIABLE (Nonce[16], U8, SEG_CODE) = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
 const SEGMENT_VARIABLE (ReferenceInitialVector[16] , U8, SEG_CODE) = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
 
-// Used to hold data that we are going to encrypt
-static __xdata uint8_t encrypt_packet[MAX_ENCRYPT_PACKET_LENGTH];
+// CTR mode sends a 6 byte packet nonce after the cipher text, which
+// goes in bytes 8-13 of the counter block. The last two bytes count
+// the blocks within the packet. The nonce is a 32 bit epoch and a 16
+// bit packet sequence number, so we never use a counter block twice
+// within an epoch. The epoch is picked at the first packet and
+// whenever the sequence number wraps, from the 2MHz timer2 count, so
+// epochs never repeat within 36 minutes of one boot, and across boots
+// depend on when the first packet went to well under a usec.
+//
+// Both ends share the key, and nothing fixes which end is which, so
+// the nonce can't carry a direction bit. Instead, an end that
+// receives its own epoch from the other end picks a new one before it
+// sends again. The cipher text is the same length as the plain text,
+// so we don't pad
+#define CTR_NONCE_OFFSET	8
+#define CTR_NONCE_LENGTH	6
+static __pdata uint32_t ctr_epoch;
+static __pdata uint16_t ctr_seq;
+static __pdata uint8_t ctr_last_len;
+static __bit ctr_started;
+static __bit ctr_repeat;
+static __xdata uint8_t ctr_tail_in[16], ctr_tail_out[16];
 
 /* Helper definitions  */
 // First nibble = code for # of bits - 1 = 128, 2 = 192, 3 = 256 
-#define	BITS(_l)	(_l)&0xf
+#define	BITS(_l)	((_l)&0xf)
 // Second nibble = crypto 0 = CBC, 1 = CTR
-#define	CRYPTO(_l)	(_l>>4)&0xf
+#define	CRYPTO(_l)	(((_l)>>4)&0xf)
 
 // Variables
 uint8_t encryption_level;
@@ -163,26 +182,69 @@ bool aes_init(uint8_t encryption_level)
 	return true;
 }
 
-// Pad out the string to encrypt to a multiple of 16 x bytes
+// Return how much plain text will encrypt to fit in len bytes
 //
-// returns the padded string
-__xdata unsigned char *aes_pad(__xdata unsigned char *in_str, uint8_t len)
+uint8_t aes_plaintext_room(uint8_t len)
 {
-	volatile uint8_t  pad_length;
-	uint8_t i;
-
-        // Copy string to encrypt to temp area, because we will be padding out encrypted string
-        // and we don't want to affect any code that might be depending upon this string...or 
-	// any characters that the padding would overwrite. e.g. the injected packet code.
-        memcpy(encrypt_packet, in_str, len);
+	if (CRYPTO(aes_get_encryption_level()) == 1) {
+		// CTR, the cipher text is followed by the nonce
+		if (len <= CTR_NONCE_LENGTH) return 0;
+		return len - CTR_NONCE_LENGTH;
+	}
+	// CBC pads to the next 16 bytes, with at least one byte of padding
+	if (len < 16) return 0;
+	return (len & ~15) - 1;
+}
 
-	pad_length = 16 - (len%16);
+// Make the next CTR packet use the same nonce as the last one. This
+// is only for resending the same plain text, which then gives the
+// same cipher text, so the receiver can spot the duplicate
+void aes_repeat_nonce(void)
+{
+	ctr_repeat = true;
+}
 
-	for (i = 0; i < pad_length;i++) {
-		memcpy(&encrypt_packet[len+i], &pad_length, sizeof(pad_length));
+// Run CTR mode over len bytes, which needn't be whole blocks. The
+// counter block must be set up first. A partial last block goes
+// through a scratch block, so we never touch bytes past len
+static uint8_t ctr_crypt(int8_t key_size_code, __xdata unsigned char *in_str, __xdata unsigned char *out_str, uint8_t len)
+{
+	uint8_t status = 0;
+	uint8_t blocks = len >> 4;
+	uint8_t tail = len & 15;
+
+	// CTR_EncryptDecrypt() takes the plain text pointer first
+	if (blocks != 0) {
+		if (key_size_code & ENCRYPTION_MODE) {
+			status = CTR_EncryptDecrypt (key_size_code, in_str, out_str, Counter, EncryptionKey, blocks);
+		} else {
+			status = CTR_EncryptDecrypt (key_size_code, out_str, in_str, Counter, EncryptionKey, blocks);
+		}
+	}
+	if (status == 0 && tail != 0) {
+		// CTR_EncryptDecrypt() leaves the counter at the last block
+		// it used. There are at most 15 blocks, so no carry
+		if (blocks != 0) {
+			Counter[15]++;
+		}
+		memcpy(ctr_tail_in, &in_str[len - tail], tail);
+		if (key_size_code & ENCRYPTION_MODE) {
+			status = CTR_EncryptDecrypt (key_size_code, ctr_tail_in, ctr_tail_out, Counter, EncryptionKey, 1);
+		} else {
+			status = CTR_EncryptDecrypt (key_size_code, ctr_tail_out, ctr_tail_in, Counter, EncryptionKey, 1);
+		}
+		memcpy(&out_str[len - tail], ctr_tail_out, tail);
 	}
+	return status;
+}
 
-	return encrypt_packet;
+// Load the counter block for a packet nonce
+static void ctr_counter_init(__xdata unsigned char *nonce)
+{
+	aesCopyInit2(Counter, Nonce);
+	memcpy(&Counter[CTR_NONCE_OFFSET], nonce, CTR_NONCE_LENGTH);
+	Counter[14] = 0;
+	Counter[15] = 0;
 }
 
 // encrypt the data pointed to by in_str with length len
@@ -196,7 +258,7 @@ uint8_t aes_encrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsig
 	int8_t key_size_code;
 	uint8_t status;
 	uint8_t blocks;
-	__xdata unsigned char *pt;
+	uint8_t pad_length;
 
 	// Make sure we have something to encrypt
 	if (in_len == 0) return 0;
@@ -235,28 +297,45 @@ uint8_t aes_encrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsig
 	// e.g. 01 02 03 05 06 01 02 03 05 06 06 01 was just 15 bytes long...and the
 	// last byte is a 01...is padding
 
-	// Copy String into XDATA
-	pt = aes_pad(in_str, in_len); 
+	if (crypto_type == 1) {
+		// CTR needs no padding. Pick the packet nonce, reusing
+		// the last one only to resend the same packet
+		if (!ctr_repeat || !ctr_started || in_len != ctr_last_len) {
+			ctr_seq++;
+			if (!ctr_started || ctr_seq == 0) {
+				ctr_epoch = (timer2_tick32() << 5) ^ ((uint32_t)radio_current_rssi() << 24) ^ timer_entropy();
+				ctr_seq = 0;
+				ctr_started = true;
+			}
+		}
+		ctr_repeat = false;
+		ctr_last_len = in_len;
+		out_str[in_len] = ctr_epoch >> 24;
+		out_str[in_len+1] = ctr_epoch >> 16;
+		out_str[in_len+2] = ctr_epoch >> 8;
+		out_str[in_len+3] = ctr_epoch & 0xFF;
+		out_str[in_len+4] = ctr_seq >> 8;
+		out_str[in_len+5] = ctr_seq & 0xFF;
+		ctr_counter_init(&out_str[in_len]);
+		status = ctr_crypt(key_size_code, in_str, out_str, in_len);
+		*out_len = in_len + CTR_NONCE_LENGTH;
+		return status;
+	}
+
+	// CBC pads the plain text in the output buffer and encrypts it
+	// there. The initial vector goes in the 16 bytes before it, so
+	// the DMA does every block in one pass
+	if (in_str != out_str) {
+		memcpy(out_str, in_str, in_len);
+	}
+	pad_length = 16 - (in_len & 15);
+	memset(&out_str[in_len], pad_length, pad_length);
+	memcpy(out_str - 16, InitialVector, 16);
 
 	// Calculate # of blocks we need to encrypt
 	blocks = 1 + (in_len>>4); // Number of 16-byte blocks to encrypt
 
-	// Based on crypto_type, perform the encryption
-	switch(crypto_type)
-	{
-		case 0:
-			// Validate CBC Mode encryption
-			status = CBC_EncryptDecrypt (key_size_code, pt, out_str, InitialVector, EncryptionKey, blocks);
-			break;
-		case 1:
-			// Perform CTR Mode decryption
-			aesCopyInit2(Counter, Nonce);
-			status = CTR_EncryptDecrypt (key_size_code, pt, out_str, Counter, EncryptionKey, blocks);
-			break;
-		default:
-			// Validate CBC Mode encryption
-			status = CBC_EncryptDecrypt (key_size_code, pt, out_str, InitialVector, EncryptionKey, blocks);
-	}
+	status = CBC_EncryptInPlace (key_size_code, out_str, EncryptionKey, blocks);
 
 	// Set size of encrypted cipher in bytes
 	*out_len = 16 * blocks;
@@ -266,7 +345,9 @@ uint8_t aes_encrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsig
 
 
 
-// decrypt the data pointed to by in_str with length in_len
+// decrypt the data pointed to by in_str with length in_len. The data
+// came over the air and has only passed a CRC check, so a length that
+// can't be cipher text is an error rather than a panic
 //
 // returns a number indicate outcome. 0 is success
 uint8_t aes_decrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsigned char *out_str,
@@ -310,6 +391,27 @@ uint8_t aes_decrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsig
 	// 1 - CTR
 	crypto_type = CRYPTO(encryption);
 
+	if (crypto_type == 1) {
+		// CTR, the nonce follows the cipher text
+		if (in_len <= CTR_NONCE_LENGTH) return 1;
+		in_len -= CTR_NONCE_LENGTH;
+		if (ctr_started &&
+		    in_str[in_len] == (uint8_t)(ctr_epoch >> 24) &&
+		    in_str[in_len+1] == (uint8_t)(ctr_epoch >> 16) &&
+		    in_str[in_len+2] == (uint8_t)(ctr_epoch >> 8) &&
+		    in_str[in_len+3] == (uint8_t)ctr_epoch) {
+			// the other end is using our epoch, so its counter
+			// blocks are ours too. Take a new one
+			ctr_started = false;
+		}
+		ctr_counter_init(&in_str[in_len]);
+		*out_len = in_len;
+		return ctr_crypt(key_size_code, in_str, out_str, in_len);
+	}
+
+	// CBC is whole blocks, with at least one byte of padding
+	if (in_len < 16 || (in_len & 15) != 0) return 1;
+
 	// Calculate # of 16-byte blocks
 	blocks = in_len>>4; 
 
@@ -323,11 +425,6 @@ uint8_t aes_decrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsig
 			// Perform CBC Mode decryption
 			status = CBC_EncryptDecrypt (key_size_code, out_str, ct, InitialVector, DecryptionKey, blocks);
 			break;
-		case 1:
-			// Perform CTR Mode decryption  (For CTR - DecryptionKey = EncryptionKey)
-			aesCopyInit2(Counter, Nonce);
-			status = CTR_EncryptDecrypt (key_size_code, out_str, ct, Counter, EncryptionKey, blocks);
-			break;
 		default:
 			// Perform CBC Mode decryption
 			status = CBC_EncryptDecrypt (key_size_code, out_str, ct, InitialVector, DecryptionKey, blocks);
@@ -335,6 +432,7 @@ uint8_t aes_decrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsig
 			
 
 	// Set size of decrypted ciper text, taking into account the padding
+	if (out_str[16 * blocks - 1] == 0 || out_str[16 * blocks - 1] > 16) return 1;
 	*out_len = in_len - out_str[16 * blocks - 1];
 
 	return status;
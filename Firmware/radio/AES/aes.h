@@ -37,6 +37,7 @@
 // Function Prototypes
 //-----------------------------------------------------------------------------
 
+// CBC uses the 16 bytes before out_str, so there must be space there
 extern uint8_t aes_encrypt(__xdata unsigned char *in_str, uint8_t in_len, __xdata unsigned char *out_str, uint8_t *out_len);
 
 extern bool aes_init(uint8_t encryption_level);
@@ -45,6 +46,10 @@ extern uint8_t aes_decrypt(__xdata unsigned char *in_str,  uint8_t in_len, __xda
 
 extern uint8_t aes_get_encryption_level();
 
+extern uint8_t aes_plaintext_room(uint8_t len);
+
+extern void aes_repeat_nonce(void);
+
 void aes_set_encryption_level(uint8_t encryption);
 
 #define AES_KEY_LENGTH(_l)    8*(1 +(_l&0xf))
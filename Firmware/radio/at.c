@@ -34,6 +34,7 @@
 
 #include "radio.h"
 #include "tdm.h"
+#include "latency.h"
 #include "flash_layout.h"
 #include "at.h"
 #include "board.h"
@@ -116,105 +117,21 @@ at_input(register uint8_t c)
 }
 #pragma restore
 
-// +++ detector state machine
-//
-// states:
-//
-// wait_for_idle:	-> wait_for_plus1, count = 0 after 1s
-//
-// wait_for_plus:	-> wait_for_idle if char != +
-//			-> wait_for_plus, count++ if count < 3
-// wait_for_enable:	-> enabled after 1s
-//			-> wait_for_idle if any char
-//
-
-#define	ATP_WAIT_FOR_IDLE	0
-#define ATP_WAIT_FOR_PLUS1	1
-#define ATP_WAIT_FOR_PLUS2	2
-#define ATP_WAIT_FOR_PLUS3	3
-#define ATP_WAIT_FOR_ENABLE	4
-
-#define ATP_COUNT_1S		100	// 100 ticks of the 100Hz timer
-
-static __pdata uint8_t	at_plus_state;
-static __pdata uint8_t	at_plus_counter = ATP_COUNT_1S;
-
-#pragma save
-#pragma nooverlay
-void
-at_plus_detector(register uint8_t c)
-{
-	// If we get a character that's not '+', unconditionally
-	// reset the state machine to wait-for-idle; this will
-	// restart the 1S timer.
-	//
-	if (c != (uint8_t)'+')
-		at_plus_state = ATP_WAIT_FOR_IDLE;
-
-	// We got a plus; handle it based on our current state.
-	//
-	switch (at_plus_state) {
-
-	case ATP_WAIT_FOR_PLUS1:
-	case ATP_WAIT_FOR_PLUS2:
-		at_plus_state++;
-		break;
-
-	case ATP_WAIT_FOR_PLUS3:
-		at_plus_state = ATP_WAIT_FOR_ENABLE;
-		at_plus_counter = ATP_COUNT_1S;
-		break;
-
-	default:
-		at_plus_state = ATP_WAIT_FOR_IDLE;
-		// FALLTHROUGH
-	case ATP_WAIT_FOR_IDLE:
-	case ATP_WAIT_FOR_ENABLE:
-		at_plus_counter = ATP_COUNT_1S;
-		break;
-	}
-}
-#pragma restore
-
-#pragma save
-#pragma nooverlay
 void
-at_timer(void)
+at_command(void)
 {
-	// if the counter is running
-	if (at_plus_counter > 0) {
-
-		// if it reaches zero, the timeout has expired
-		if (--at_plus_counter == 0) {
-
-			// make the relevant state change
-			switch (at_plus_state) {
-			case ATP_WAIT_FOR_IDLE:
-				at_plus_state = ATP_WAIT_FOR_PLUS1;
-				break;
-
-			case ATP_WAIT_FOR_ENABLE:
-				at_mode_active = true;
-				at_plus_state = ATP_WAIT_FOR_IDLE;
-
-				// stuff an empty 'AT' command to get the OK prompt
-				at_cmd[0] = 'A';
-				at_cmd[1] = 'T';
-				at_cmd[2] = '\0';
-				at_cmd_len = 2;
-				at_cmd_ready = true;
-				break;
-			default:
-				// should never happen, but otherwise harmless
-			}
-		}
+	// look for the +++ escape sequence
+	if (!at_mode_active && serial_escape_detect()) {
+		at_mode_active = true;
+
+		// stuff an empty 'AT' command to get the OK prompt
+		at_cmd[0] = 'A';
+		at_cmd[1] = 'T';
+		at_cmd[2] = '\0';
+		at_cmd_len = 2;
+		at_cmd_ready = true;
 	}
-}
-#pragma restore
 
-void
-at_command(void)
-{
 	// require a command with the AT prefix
 	if (at_cmd_ready) {
 		if ((at_cmd_len >= 2) && (at_cmd[0] == 'R') && (at_cmd[1] == 'T')) {
@@ -246,7 +163,7 @@ at_command(void)
 				at_p();
 				break;
 			case 'O':		// O -> go online (exit command mode)
-				at_plus_counter = ATP_COUNT_1S;
+				serial_escape_reset();
 				at_mode_active = 0;
 				break;
 			case 'S':
@@ -347,6 +264,11 @@ at_i(void)
   case '7':
     tdm_show_rssi();
     return;
+#ifdef LATENCY_MEASURE
+  case '8':
+    latency_report();
+    return;
+#endif
   default:
     at_error();
     return;
@@ -434,6 +356,12 @@ at_ampersand(void)
 		} else if (!strcmp(at_cmd + 4, "=TDM")) {
 			// display TDM debug
 			at_testmode ^= AT_TEST_TDM;
+#ifdef LATENCY_MEASURE
+		} else if (!strcmp(at_cmd + 4, "=LAT")) {
+			// measure latency, starting from empty histograms
+			at_testmode ^= AT_TEST_LATENCY;
+			latency_reset();
+#endif
 		} else {
 			at_error();
 		}
@@ -586,6 +514,11 @@ at_plus(void)
 #endif //BOARD_rfd900a / BOARD_rfd900p
 #ifdef RFD900_DIVERSITY
   case 'A':
+    if (at_cmd[4] == '?')
+    {
+      radio_diversity_report();
+      return;
+    }
     if (at_cmd[4] != '=')
     {
       break;
@@ -595,6 +528,9 @@ at_plus(void)
     if (at_num == 1) {
       radio_set_diversity(DIVERSITY_ANT1);
     }
+    else if (at_num == 3) {
+      radio_set_diversity(DIVERSITY_SOFTWARE);
+    }
     else {
       radio_set_diversity(DIVERSITY_ANT2);
     }
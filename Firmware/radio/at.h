@@ -38,20 +38,6 @@
 extern bool	at_mode_active;	///< if true, the AT interpreter is in command mode
 extern bool	at_cmd_ready;	///< if true, at_cmd / at_cmd_len contain valid data
 
-/// Timer tick handler for the AT command interpreter
-///
-extern void	at_timer(void);
-
-/// +++ detector.  Handles the state machine for detecting the AT escape
-/// sequence.
-///
-/// Call this at interrupt time for every incoming character when at_mode_active
-/// is false.
-///
-/// @param	c		Received character.
-///
-extern void	at_plus_detector(register uint8_t c);
-
 /// AT command character input method.
 ///
 /// Call this at interrupt time for every incoming character when at_mode_active
@@ -73,6 +59,7 @@ extern __pdata uint8_t  at_testmode;    ///< AT_TEST_* bits
 
 #define AT_TEST_RSSI 1
 #define AT_TEST_TDM  2
+#define AT_TEST_LATENCY 4
 
 // max size of an AT command
 #ifdef CPU_SI1030
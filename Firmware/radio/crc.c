@@ -37,6 +37,8 @@
 #include "radio.h"
 #include "crc.h"
 
+#if defined(CRC_SOFTWARE) || defined(CRC_TEST)
+
 // CRC tables
 static __code uint8_t crc_tab1[256] =
 {
@@ -82,7 +84,7 @@ static __code uint8_t crc_tab2[256] =
 // calculate the CRC16 of a buffer
 // this costs about 2.2 microseconds per byte
 uint16_t 
-crc16(__data uint8_t n, __xdata uint8_t * __data buf)
+crc16_table(__data uint8_t n, __xdata uint8_t * __data buf)
 {
 	register uint8_t k;
 	register uint8_t high, low;
@@ -102,3 +104,113 @@ crc16(__data uint8_t n, __xdata uint8_t * __data buf)
 	}
 	return (((uint16_t)high)<<8) | low;
 }
+#endif // CRC_SOFTWARE || CRC_TEST
+
+#ifdef CRC_SOFTWARE
+uint16_t 
+crc16(__data uint8_t n, __xdata uint8_t * __data buf)
+{
+	return crc16_table(n, buf);
+}
+
+uint16_t
+crc16_copy(__data uint8_t n, __xdata uint8_t * __data dst, __xdata uint8_t * __data src, __data uint16_t crc)
+{
+	register uint8_t k;
+	register uint8_t high, low;
+
+	high = crc >> 8;
+	low = crc;
+
+	while (n--) {
+		register uint8_t b = *src++;
+		*dst++ = b;
+		k = high << 1;
+		if (high & 0x80) {
+			high = low ^ crc_tab2[k++];
+			low = b ^ crc_tab2[k];
+		} else {
+			high = low ^ crc_tab1[k++];
+			low = b ^ crc_tab1[k];
+		}
+	}
+	return (((uint16_t)high)<<8) | low;
+}
+#else
+
+// CRC0CN settings: 16 bit CCITT (0x1021) mode, plus the result
+// initialise bit and the result byte pointer
+#define CRC0_16BIT	0x10
+#define CRC0_RESET	0x08
+#define CRC0_PNT_HIGH	0x01
+
+// calculate the CRC16 of a buffer using the CRC0 engine
+// this costs about 0.4 microseconds per byte
+//
+// The tables above shift each byte into the bottom of the CRC
+// register, so the last two bytes are never multiplied through
+// the polynomial. CRC0 computes the usual CCITT CRC with an initial
+// value of zero, so we feed it all but the last two bytes and XOR
+// those into the result, which gives exactly the same value.
+//
+// CRC0 shares its SFR addresses with timer3 on CRC0_PAGE. Interrupts
+// automatically switch to their own SFR page, so we only need to put
+// the page back when we are done.
+uint16_t 
+crc16(__data uint8_t n, __xdata uint8_t * __data buf)
+{
+	register uint8_t high, low;
+	uint8_t old_page;
+
+	if (n < 2) {
+		return n ? buf[0] : 0;
+	}
+	n -= 2;
+
+	old_page = SFRPAGE;
+	SFRPAGE = CRC0_PAGE;
+	CRC0CN = CRC0_16BIT | CRC0_RESET;
+	while (n--) {
+		CRC0IN = *buf++;
+	}
+	CRC0CN = CRC0_16BIT | CRC0_PNT_HIGH;
+	high = CRC0DAT;
+	CRC0CN = CRC0_16BIT;
+	low = CRC0DAT;
+	SFRPAGE = old_page;
+
+	high ^= buf[0];
+	low ^= buf[1];
+	return (((uint16_t)high)<<8) | low;
+}
+
+// The CRC so far goes in as two leading bytes, which is the same as
+// starting the engine from it. As in crc16() the engine runs two
+// bytes behind the data, and the last two are xored in at the end
+uint16_t
+crc16_copy(__data uint8_t n, __xdata uint8_t * __data dst, __xdata uint8_t * __data src, __data uint16_t crc)
+{
+	register uint8_t high, low;
+	uint8_t old_page;
+
+	high = crc >> 8;
+	low = crc;
+
+	old_page = SFRPAGE;
+	SFRPAGE = CRC0_PAGE;
+	CRC0CN = CRC0_16BIT | CRC0_RESET;
+	while (n--) {
+		CRC0IN = high;
+		high = low;
+		low = *src++;
+		*dst++ = low;
+	}
+	CRC0CN = CRC0_16BIT | CRC0_PNT_HIGH;
+	high ^= CRC0DAT;
+	CRC0CN = CRC0_16BIT;
+	low ^= CRC0DAT;
+	SFRPAGE = old_page;
+
+	return (((uint16_t)high)<<8) | low;
+}
+#endif // CRC_SOFTWARE
@@ -26,6 +26,11 @@
 // OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+// crc16() uses the CRC0 engine on both the Si100x and Si102x/3x,
+// which is several times faster than the lookup tables. Define
+// CRC_SOFTWARE to use the table driven version instead, or CRC_TEST
+// to build both so crc_test() can compare them.
+
 /// calculate a CRC16 on a buffer
 /// @param n		number of bytes
 /// @param buf		buffer
@@ -33,3 +38,27 @@
 /// @return		CRC16 value
 ///
 extern uint16_t crc16(__data uint8_t n, __xdata uint8_t * __data buf);
+
+/// copy a buffer, carrying a CRC16 on over the bytes as they go. The
+/// CRC of a packet built in pieces is the same as crc16() of the lot,
+/// starting from zero. dst may be src, to carry the CRC on over bytes
+/// already in place
+/// @param n		number of bytes
+/// @param dst		buffer to copy to
+/// @param src		buffer to copy from
+/// @param crc		CRC16 of the bytes before these, or zero
+///
+/// @return		CRC16 value
+///
+extern uint16_t crc16_copy(__data uint8_t n, __xdata uint8_t * __data dst, __xdata uint8_t * __data src, __data uint16_t crc);
+
+#if defined(CRC_SOFTWARE) || defined(CRC_TEST)
+/// calculate a CRC16 on a buffer using the lookup tables. This gives
+/// the same result as crc16()
+/// @param n		number of bytes
+/// @param buf		buffer
+///
+/// @return		CRC16 value
+///
+extern uint16_t crc16_table(__data uint8_t n, __xdata uint8_t * __data buf);
+#endif
@@ -38,102 +38,218 @@
 
 #ifdef INCLUDE_GOLAY
 
-// intermediate arrays for encodeing/decoding. Using these
-// saves some interal memory that would otherwise be needed
-// for pointers
-static __pdata uint8_t g3[3], g6[6];
-
-// encode 3 bytes data into 6 bytes of coded data
-// input is in g3[], output in g6[]
-static void 
-golay_encode24(void)
+#ifdef GOLAY_COMPACT
+#define GOLAY_ENCODE(_syn, _v) _syn = golay23_encode_lo[(uint8_t)(_v)] ^ golay23_encode_hi[(_v) >> 8]
+#define GOLAY_ERROR(_e, _syn) _e = golay_error(_syn)
+
+// the number of bits set in a 12 bit value
+#define GOLAY_WEIGHT(_x) (golay23_weight[(uint8_t)(_x)] + golay23_weight[(_x) >> 8])
+
+// find the data bits in error from a syndrome, in place of the 4k
+// golay23_decode[] table. A virtual 24th bit extends the word to the
+// self-dual (24,12) golay code, chosen to give the error odd weight,
+// so it still has at most 3 bits. With A the parity matrix of that
+// code the syndrome is s = d.A + p for data and parity errors d and p,
+// and as A.A' = I, s.A' = d + p.A'. One of d and p has at most one
+// bit set, which is found by trying each row of A or A'
+static uint16_t
+golay_error(__data uint16_t syn)
 {
-	__pdata uint16_t v;
-	__pdata uint16_t syn;
-
-	v = g3[0] | ((uint16_t)g3[1] & 0x0F) << 8;
-	syn = golay23_encode[v];
-	g6[0] = syn & 0xFF;
-	g6[1] = (g3[0] & 0x1F) << 3 | syn >> 8;
-	g6[2] = (g3[0] & 0xE0) >> 5 | (g3[1] & 0x0F) << 3;
-
-	v = g3[2] | ((uint16_t)g3[1] & 0xF0) << 4;
-	syn = golay23_encode[v];
-	g6[3] = syn & 0xFF;
-	g6[4] = (g3[2] & 0x1F) << 3 | syn >> 8;
-	g6[5] = (g3[2] & 0xE0) >> 5 | (g3[1] & 0xF0) >> 1;
+	__data uint16_t s;
+	__data uint8_t i, w;
+
+	w = GOLAY_WEIGHT(syn);
+	if ((w & 1) == 0) {
+		syn |= 0x800;
+		w++;
+	}
+
+	// all the errors are in the parity bits
+	if (w <= 3) {
+		return 0;
+	}
+
+	// one data bit, and up to two parity bits
+	for (i = 0; i < 12; i++) {
+		s = syn ^ golay23_rows[i];
+		if (GOLAY_WEIGHT(s) <= 2) {
+			return (uint16_t)1 << i;
+		}
+	}
+
+	// no parity bits
+	syn = golay23_transpose_lo[(uint8_t)syn] ^ golay23_transpose_hi[syn >> 8];
+	if (GOLAY_WEIGHT(syn) <= 3) {
+		return syn;
+	}
+
+	// one parity bit, and up to two data bits
+	for (i = 0; i < 12; i++) {
+		s = syn ^ golay23_columns[i];
+		if (GOLAY_WEIGHT(s) <= 2) {
+			return s;
+		}
+	}
+
+	// the code is perfect, so every syndrome is covered above
+	return 0;
 }
+#else // GOLAY_COMPACT
+#ifdef CPU_SI1030
+// the tables are in flash bank 1, which has to be the constant bank
+// (COBANK) while they are read. Interrupts are held off meanwhile, as
+// the handlers expect to read their constants from bank 3
+#define GOLAY_LOOKUP(_v, _table, _i) __critical { PSBANK = 0x13; _v = _table[_i]; PSBANK = 0x33; }
+#else
+#define GOLAY_LOOKUP(_v, _table, _i) _v = _table[_i]
+#endif
+#define GOLAY_ENCODE(_syn, _v) GOLAY_LOOKUP(_syn, golay23_encode, _v)
+#define GOLAY_ERROR(_e, _syn) GOLAY_LOOKUP(_e, golay23_decode, _syn)
+#endif // GOLAY_COMPACT
 
 // encode n bytes of data into 2n coded bytes. n must be a multiple 3
-// encoding takes about 6 microseconds per input byte
+//
+// each 3 bytes hold two 12 bit words, the first in byte 0 and the low
+// half of byte 1, the second in byte 2 and the high half of byte 1.
+// Each word is sent as 11 bits of syndrome then its 12 data bits,
+// packed low byte first into 3 coded bytes
 void 
 golay_encode(__pdata uint8_t n, __xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out)
 {
-	while (n >= 3) {
-		g3[0] = in[0]; g3[1] = in[1]; g3[2] = in[2];
-		golay_encode24();
-		out[0] = g6[0]; out[1] = g6[1]; out[2] = g6[2]; 
-		out[3] = g6[3]; out[4] = g6[4]; out[5] = g6[5]; 
-		in += 3;
-		out += 6;
-		n -= 3;
-	}
-}
-
-// decode 6 bytes of coded data into 3 bytes of original data
-// input is in g6[], output in g3[]
-// returns the number of words corrected (0, 1 or 2)
-static uint8_t 
-golay_decode24(void)
-{
+	__xdata uint8_t * __data src = in;
+	__xdata uint8_t * __data dst = out;
+	__data uint8_t b0, b1, b2;
 	__data uint16_t v;
 	__data uint16_t syn;
-	__data uint16_t e;
-	__pdata uint8_t errcount = 0;
-
-	v = (g6[2] & 0x7F) << 5 | (g6[1] & 0xF8) >> 3;
-	syn = golay23_encode[v];
-	syn ^= g6[0] | (g6[1] & 0x07) << 8;
-	e = golay23_decode[syn];
-	if (e) {
-		errcount++;
-		v ^= e;
-	}
-	g3[0] = v & 0xFF;
-	g3[1] = v >> 8;
-
-	v = (g6[5] & 0x7F) << 5 | (g6[4] & 0xF8) >> 3;
-	syn = golay23_encode[v];
-	syn ^= g6[3] | (g6[4] & 0x07) << 8;
-	e = golay23_decode[syn];
-	if (e) {
-		errcount++;
-		v ^= e;
-	}
-	g3[1] |= (v >> 4) & 0xF0;
-	g3[2] = v & 0xFF;
 
-	return errcount;
+	while (n >= 3) {
+		b0 = *src++;
+		b1 = *src++;
+		b2 = *src++;
+
+		v = b0 | (uint16_t)(b1 & 0x0F) << 8;
+		GOLAY_ENCODE(syn, v);
+		*dst++ = syn & 0xFF;
+		*dst++ = b0 << 3 | syn >> 8;
+		*dst++ = b0 >> 5 | (b1 & 0x0F) << 3;
+
+		v = b2 | (uint16_t)(b1 & 0xF0) << 4;
+		GOLAY_ENCODE(syn, v);
+		*dst++ = syn & 0xFF;
+		*dst++ = b2 << 3 | syn >> 8;
+		*dst++ = b2 >> 5 | (b1 & 0xF0) >> 1;
+
+		n -= 3;
+	}
 }
 
 // decode n bytes of coded data into n/2 bytes of original data
 // n must be a multiple of 6
-// decoding takes about 4 microseconds per input byte
 // the number of 12 bit words that required correction is returned
+//
+// out may be in itself or before it, as the output moves at half the
+// speed of the input and so never overwrites coded bytes not yet read
 uint8_t 
 golay_decode(__pdata uint8_t n, __xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out)
 {
-	__pdata uint8_t errcount = 0;
+	__xdata uint8_t * __data src = in;
+	__xdata uint8_t * __data dst = out;
+	__data uint8_t c0, c1, c2, hi;
+	__data uint16_t v;
+	__data uint16_t syn;
+	__data uint16_t e;
+	__data uint8_t errcount = 0;
+
 	while (n >= 6) {
-		g6[0] = in[0]; g6[1] = in[1]; g6[2] = in[2];
-		g6[3] = in[3]; g6[4] = in[4]; g6[5] = in[5];
-		errcount += golay_decode24();
-		out[0] = g3[0]; out[1] = g3[1]; out[2] = g3[2];
-		in += 6;
-		out += 3;
+		c0 = *src++;
+		c1 = *src++;
+		c2 = *src++;
+		v = (uint16_t)(c2 & 0x7F) << 5 | c1 >> 3;
+		GOLAY_ENCODE(syn, v);
+		syn ^= c0 | (uint16_t)(c1 & 0x07) << 8;
+		GOLAY_ERROR(e, syn);
+		if (e) {
+			errcount++;
+			v ^= e;
+		}
+		*dst++ = v & 0xFF;
+		hi = v >> 8;
+
+		c0 = *src++;
+		c1 = *src++;
+		c2 = *src++;
+		v = (uint16_t)(c2 & 0x7F) << 5 | c1 >> 3;
+		GOLAY_ENCODE(syn, v);
+		syn ^= c0 | (uint16_t)(c1 & 0x07) << 8;
+		GOLAY_ERROR(e, syn);
+		if (e) {
+			errcount++;
+			v ^= e;
+		}
+		*dst++ = hi | ((v >> 4) & 0xF0);
+		*dst++ = v & 0xFF;
+
 		n -= 6;
 	}
 	return errcount;
 }
 
+// interleave 8 golay words, 24 coded bytes, so that each output byte
+// holds the same bit of all 8 words, word w in bit w. The output byte
+// for bit c of the words goes to out[c*stride]
+void
+golay_interleave(__xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out, __pdata uint8_t stride)
+{
+	__xdata uint8_t * __data src;
+	__xdata uint8_t * __data dst = out;
+	__data uint8_t x[8];
+	__data uint8_t k, b, w, o;
+
+	for (k = 0; k < 3; k++) {
+		// byte k of each word
+		src = &in[k];
+		for (w = 0; w < 8; w++) {
+			x[w] = *src;
+			src += 3;
+		}
+		for (b = 0; b < 8; b++) {
+			o = 0;
+			for (w = 0; w < 8; w++) {
+				o = (o >> 1) | (x[w] << 7);
+				x[w] >>= 1;
+			}
+			*dst = o;
+			dst += stride;
+		}
+	}
+}
+
+// the reverse of golay_interleave(), gathering 24 bytes from
+// in[c*stride] back into 8 golay words
+void
+golay_deinterleave(__xdata uint8_t * __pdata in, __pdata uint8_t stride, __xdata uint8_t * __pdata out)
+{
+	__xdata uint8_t * __data src = in;
+	__xdata uint8_t * __data dst;
+	__data uint8_t x[8];
+	__data uint8_t k, b, w, o;
+
+	for (k = 0; k < 3; k++) {
+		for (b = 0; b < 8; b++) {
+			o = *src;
+			src += stride;
+			for (w = 0; w < 8; w++) {
+				x[w] = (x[w] >> 1) | (o << 7);
+				o >>= 1;
+			}
+		}
+		// x[] is now byte k of each word
+		dst = &out[k];
+		for (w = 0; w < 8; w++) {
+			*dst = x[w];
+			dst += 3;
+		}
+	}
+}
+
 #endif // INCLUDE_GOLAY
@@ -40,4 +40,16 @@ extern void golay_encode(__pdata uint8_t n, __xdata uint8_t * __pdata in, __xdat
 /// decode n bytes of coded data into n/2 bytes of original data
 /// n must be a multiple of 6
 extern uint8_t golay_decode(__pdata uint8_t n, __xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out);
+
+/// the number of groups of 8 words that n coded bytes are interleaved
+/// in. A group is 24 bytes on air
+#define GOLAY_INTERLEAVE_GROUPS(n) (((n)/3 + 7) / 8)
+
+/// interleave 8 coded words from in, one bit of each word per byte,
+/// writing the 24 bytes stride bytes apart from out
+extern void golay_interleave(__xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out, __pdata uint8_t stride);
+
+/// gather 24 bytes stride bytes apart from in, and undo golay_interleave()
+/// into 8 coded words at out
+extern void golay_deinterleave(__xdata uint8_t * __pdata in, __pdata uint8_t stride, __xdata uint8_t * __pdata out);
 #endif // INCLUDE_GOLAY
\ No newline at end of file
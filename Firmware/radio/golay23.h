@@ -35,12 +35,137 @@
 #ifndef _GOLAY23_H_
 #define _GOLAY23_H_
 
-#ifndef INCLUDE_AES
-#define INCLUDE_GOLAY
-#endif
-
 #ifdef INCLUDE_GOLAY
 
+#ifdef GOLAY_COMPACT
+
+// golay23_encode[] is linear in the data, so it is kept as two tables,
+// for data bits 0-7 and 8-11, and the syndrome of v is
+// golay23_encode_lo[v & 0xFF] ^ golay23_encode_hi[v >> 8]
+static const __code uint16_t golay23_encode_lo[256] = {
+0x0000U, 0x0475U, 0x049fU, 0x00eaU, 0x054bU, 0x013eU, 0x01d4U, 0x05a1U, 
+0x06e3U, 0x0296U, 0x027cU, 0x0609U, 0x03a8U, 0x07ddU, 0x0737U, 0x0342U, 
+0x01b3U, 0x05c6U, 0x052cU, 0x0159U, 0x04f8U, 0x008dU, 0x0067U, 0x0412U, 
+0x0750U, 0x0325U, 0x03cfU, 0x07baU, 0x021bU, 0x066eU, 0x0684U, 0x02f1U, 
+0x0366U, 0x0713U, 0x07f9U, 0x038cU, 0x062dU, 0x0258U, 0x02b2U, 0x06c7U, 
+0x0585U, 0x01f0U, 0x011aU, 0x056fU, 0x00ceU, 0x04bbU, 0x0451U, 0x0024U, 
+0x02d5U, 0x06a0U, 0x064aU, 0x023fU, 0x079eU, 0x03ebU, 0x0301U, 0x0774U, 
+0x0436U, 0x0043U, 0x00a9U, 0x04dcU, 0x017dU, 0x0508U, 0x05e2U, 0x0197U, 
+0x06ccU, 0x02b9U, 0x0253U, 0x0626U, 0x0387U, 0x07f2U, 0x0718U, 0x036dU, 
+0x002fU, 0x045aU, 0x04b0U, 0x00c5U, 0x0564U, 0x0111U, 0x01fbU, 0x058eU, 
+0x077fU, 0x030aU, 0x03e0U, 0x0795U, 0x0234U, 0x0641U, 0x06abU, 0x02deU, 
+0x019cU, 0x05e9U, 0x0503U, 0x0176U, 0x04d7U, 0x00a2U, 0x0048U, 0x043dU, 
+0x05aaU, 0x01dfU, 0x0135U, 0x0540U, 0x00e1U, 0x0494U, 0x047eU, 0x000bU, 
+0x0349U, 0x073cU, 0x07d6U, 0x03a3U, 0x0602U, 0x0277U, 0x029dU, 0x06e8U, 
+0x0419U, 0x006cU, 0x0086U, 0x04f3U, 0x0152U, 0x0527U, 0x05cdU, 0x01b8U, 
+0x02faU, 0x068fU, 0x0665U, 0x0210U, 0x07b1U, 0x03c4U, 0x032eU, 0x075bU, 
+0x01edU, 0x0598U, 0x0572U, 0x0107U, 0x04a6U, 0x00d3U, 0x0039U, 0x044cU, 
+0x070eU, 0x037bU, 0x0391U, 0x07e4U, 0x0245U, 0x0630U, 0x06daU, 0x02afU, 
+0x005eU, 0x042bU, 0x04c1U, 0x00b4U, 0x0515U, 0x0160U, 0x018aU, 0x05ffU, 
+0x06bdU, 0x02c8U, 0x0222U, 0x0657U, 0x03f6U, 0x0783U, 0x0769U, 0x031cU, 
+0x028bU, 0x06feU, 0x0614U, 0x0261U, 0x07c0U, 0x03b5U, 0x035fU, 0x072aU, 
+0x0468U, 0x001dU, 0x00f7U, 0x0482U, 0x0123U, 0x0556U, 0x05bcU, 0x01c9U, 
+0x0338U, 0x074dU, 0x07a7U, 0x03d2U, 0x0673U, 0x0206U, 0x02ecU, 0x0699U, 
+0x05dbU, 0x01aeU, 0x0144U, 0x0531U, 0x0090U, 0x04e5U, 0x040fU, 0x007aU, 
+0x0721U, 0x0354U, 0x03beU, 0x07cbU, 0x026aU, 0x061fU, 0x06f5U, 0x0280U, 
+0x01c2U, 0x05b7U, 0x055dU, 0x0128U, 0x0489U, 0x00fcU, 0x0016U, 0x0463U, 
+0x0692U, 0x02e7U, 0x020dU, 0x0678U, 0x03d9U, 0x07acU, 0x0746U, 0x0333U, 
+0x0071U, 0x0404U, 0x04eeU, 0x009bU, 0x053aU, 0x014fU, 0x01a5U, 0x05d0U, 
+0x0447U, 0x0032U, 0x00d8U, 0x04adU, 0x010cU, 0x0579U, 0x0593U, 0x01e6U, 
+0x02a4U, 0x06d1U, 0x063bU, 0x024eU, 0x07efU, 0x039aU, 0x0370U, 0x0705U, 
+0x05f4U, 0x0181U, 0x016bU, 0x051eU, 0x00bfU, 0x04caU, 0x0420U, 0x0055U, 
+0x0317U, 0x0762U, 0x0788U, 0x03fdU, 0x065cU, 0x0229U, 0x02c3U, 0x06b6U
+};
+
+static const __code uint16_t golay23_encode_hi[16] = {
+0x0000U, 0x03daU, 0x07b4U, 0x046eU, 0x031dU, 0x00c7U, 0x04a9U, 0x0773U, 
+0x063aU, 0x05e0U, 0x018eU, 0x0254U, 0x0527U, 0x06fdU, 0x0293U, 0x0149U
+};
+
+// the rows of the parity matrix of the extended (24,12) golay code.
+// These are the syndromes of each data bit, with the extra parity bit
+// as bit 11
+static const __code uint16_t golay23_rows[12] = {
+0x0c75U, 0x049fU, 0x0d4bU, 0x06e3U, 0x09b3U, 0x0b66U, 0x0eccU, 0x01edU, 
+0x03daU, 0x07b4U, 0x0b1dU, 0x0e3aU
+};
+
+// the transposed parity matrix, split like golay23_encode_lo/hi, and
+// its rows
+static const __code uint16_t golay23_transpose_lo[256] = {
+0x0000U, 0x049fU, 0x093eU, 0x0da1U, 0x06e3U, 0x027cU, 0x0fddU, 0x0b42U, 
+0x0dc6U, 0x0959U, 0x04f8U, 0x0067U, 0x0b25U, 0x0fbaU, 0x021bU, 0x0684U, 
+0x0f13U, 0x0b8cU, 0x062dU, 0x02b2U, 0x09f0U, 0x0d6fU, 0x00ceU, 0x0451U, 
+0x02d5U, 0x064aU, 0x0bebU, 0x0f74U, 0x0436U, 0x00a9U, 0x0d08U, 0x0997U, 
+0x0ab9U, 0x0e26U, 0x0387U, 0x0718U, 0x0c5aU, 0x08c5U, 0x0564U, 0x01fbU, 
+0x077fU, 0x03e0U, 0x0e41U, 0x0adeU, 0x019cU, 0x0503U, 0x08a2U, 0x0c3dU, 
+0x05aaU, 0x0135U, 0x0c94U, 0x080bU, 0x0349U, 0x07d6U, 0x0a77U, 0x0ee8U, 
+0x086cU, 0x0cf3U, 0x0152U, 0x05cdU, 0x0e8fU, 0x0a10U, 0x07b1U, 0x032eU, 
+0x01edU, 0x0572U, 0x08d3U, 0x0c4cU, 0x070eU, 0x0391U, 0x0e30U, 0x0aafU, 
+0x0c2bU, 0x08b4U, 0x0515U, 0x018aU, 0x0ac8U, 0x0e57U, 0x03f6U, 0x0769U, 
+0x0efeU, 0x0a61U, 0x07c0U, 0x035fU, 0x081dU, 0x0c82U, 0x0123U, 0x05bcU, 
+0x0338U, 0x07a7U, 0x0a06U, 0x0e99U, 0x05dbU, 0x0144U, 0x0ce5U, 0x087aU, 
+0x0b54U, 0x0fcbU, 0x026aU, 0x06f5U, 0x0db7U, 0x0928U, 0x0489U, 0x0016U, 
+0x0692U, 0x020dU, 0x0facU, 0x0b33U, 0x0071U, 0x04eeU, 0x094fU, 0x0dd0U, 
+0x0447U, 0x00d8U, 0x0d79U, 0x09e6U, 0x02a4U, 0x063bU, 0x0b9aU, 0x0f05U, 
+0x0981U, 0x0d1eU, 0x00bfU, 0x0420U, 0x0f62U, 0x0bfdU, 0x065cU, 0x02c3U, 
+0x03daU, 0x0745U, 0x0ae4U, 0x0e7bU, 0x0539U, 0x01a6U, 0x0c07U, 0x0898U, 
+0x0e1cU, 0x0a83U, 0x0722U, 0x03bdU, 0x08ffU, 0x0c60U, 0x01c1U, 0x055eU, 
+0x0cc9U, 0x0856U, 0x05f7U, 0x0168U, 0x0a2aU, 0x0eb5U, 0x0314U, 0x078bU, 
+0x010fU, 0x0590U, 0x0831U, 0x0caeU, 0x07ecU, 0x0373U, 0x0ed2U, 0x0a4dU, 
+0x0963U, 0x0dfcU, 0x005dU, 0x04c2U, 0x0f80U, 0x0b1fU, 0x06beU, 0x0221U, 
+0x04a5U, 0x003aU, 0x0d9bU, 0x0904U, 0x0246U, 0x06d9U, 0x0b78U, 0x0fe7U, 
+0x0670U, 0x02efU, 0x0f4eU, 0x0bd1U, 0x0093U, 0x040cU, 0x09adU, 0x0d32U, 
+0x0bb6U, 0x0f29U, 0x0288U, 0x0617U, 0x0d55U, 0x09caU, 0x046bU, 0x00f4U, 
+0x0237U, 0x06a8U, 0x0b09U, 0x0f96U, 0x04d4U, 0x004bU, 0x0deaU, 0x0975U, 
+0x0ff1U, 0x0b6eU, 0x06cfU, 0x0250U, 0x0912U, 0x0d8dU, 0x002cU, 0x04b3U, 
+0x0d24U, 0x09bbU, 0x041aU, 0x0085U, 0x0bc7U, 0x0f58U, 0x02f9U, 0x0666U, 
+0x00e2U, 0x047dU, 0x09dcU, 0x0d43U, 0x0601U, 0x029eU, 0x0f3fU, 0x0ba0U, 
+0x088eU, 0x0c11U, 0x01b0U, 0x052fU, 0x0e6dU, 0x0af2U, 0x0753U, 0x03ccU, 
+0x0548U, 0x01d7U, 0x0c76U, 0x08e9U, 0x03abU, 0x0734U, 0x0a95U, 0x0e0aU, 
+0x079dU, 0x0302U, 0x0ea3U, 0x0a3cU, 0x017eU, 0x05e1U, 0x0840U, 0x0cdfU, 
+0x0a5bU, 0x0ec4U, 0x0365U, 0x07faU, 0x0cb8U, 0x0827U, 0x0586U, 0x0119U
+};
+
+static const __code uint16_t golay23_transpose_hi[16] = {
+0x0000U, 0x07b4U, 0x0f68U, 0x08dcU, 0x0a4fU, 0x0dfbU, 0x0527U, 0x0293U, 
+0x0c75U, 0x0bc1U, 0x031dU, 0x04a9U, 0x063aU, 0x018eU, 0x0952U, 0x0ee6U
+};
+
+static const __code uint16_t golay23_columns[12] = {
+0x049fU, 0x093eU, 0x06e3U, 0x0dc6U, 0x0f13U, 0x0ab9U, 0x01edU, 0x03daU, 
+0x07b4U, 0x0f68U, 0x0a4fU, 0x0c75U
+};
+
+// the number of bits set in each byte
+static const __code uint8_t golay23_weight[256] = {
+0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 
+1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 
+1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 
+2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 
+1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 
+2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 
+2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 
+3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 
+1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 
+2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 
+2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 
+3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 
+2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 
+3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 
+3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 
+4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
+};
+
+#else // GOLAY_COMPACT
+
+#ifdef CPU_SI1030
+// the tables live in flash bank 1, see GOLAY_LOOKUP() in golay.c. The
+// board rules place GOLAYSEG in the top 12k of the bank, at 0x1D000,
+// and keep the bank allocator out of it
+#pragma constseg GOLAYSEG
+#endif
+
 static const __code uint16_t golay23_encode[4096] = {
 0x0000U, 0x0475U, 0x049fU, 0x00eaU, 0x054bU, 0x013eU, 0x01d4U, 0x05a1U, 
 0x06e3U, 0x0296U, 0x027cU, 0x0609U, 0x03a8U, 0x07ddU, 0x0737U, 0x0342U, 
@@ -815,5 +940,11 @@ static const __code uint16_t golay23_decode[2048] = {
 0x0022U, 0x0022U, 0x0100U, 0x0022U, 0x0200U, 0x0022U, 0x0408U, 0x0050U
 };
 
+#ifdef CPU_SI1030
+// back to the default segment for any constants that follow
+#pragma constseg CONST
+#endif
+
+#endif // GOLAY_COMPACT
 #endif // INCLUDE_GOLAY
 #endif // _GOLAY23_H_
\ No newline at end of file
@@ -0,0 +1,277 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	latency.c
+///
+/// End to end latency measurement
+///
+
+#include "radio.h"
+#include "timer.h"
+#include "packet.h"
+#include "crc.h"
+#include "latency.h"
+
+#ifdef LATENCY_MEASURE
+
+// histogram buckets double from 128usec (8 ticks). The last bucket
+// holds everything from about 2 seconds up
+#define LATENCY_BUCKETS 16
+static __xdata uint16_t latency_hist[LATENCY_STAGES][LATENCY_BUCKETS];
+
+static __code const char *__code latency_name[LATENCY_STAGES] = {
+	"window", "queue", "packet", "air", "output", "total"
+};
+
+// the sender side of a sample. We have a timestamp once the UART has
+// tagged a byte, an open time once we have had a transmit
+// opportunity after that, and send a probe once the packet carrying
+// the byte has gone
+static __bit tx_have_open;
+static __bit tx_sending;
+static __bit tx_probe_ready;
+static __xdata uint32_t tx_open, tx_prepare, tx_start;
+static __xdata struct latency_probe tx_probe;
+
+// the receiver side. The last user data packet, waiting for its bytes
+// to leave the serial port and for the matching probe to arrive
+static __bit rx_draining;
+static __bit rx_drained;
+static __bit rx_have_probe;
+static __xdata uint16_t rx_crc, rx_mark;
+#ifdef INCLUDE_AES
+// packets ahead of and including the last user data packet that are
+// still to be decrypted into the transmit ring
+static __xdata uint16_t rx_decrypts;
+#endif
+static __xdata uint32_t rx_time, rx_output;
+static __xdata struct latency_probe rx_probe;
+
+static bool
+latency_enabled(void)
+{
+	return (at_testmode & AT_TEST_LATENCY) != 0;
+}
+
+static void
+latency_record(__pdata uint8_t stage, __pdata uint32_t ticks)
+{
+	register uint8_t b = 0;
+
+	ticks >>= 3;
+	while (ticks != 0 && b < LATENCY_BUCKETS-1) {
+		ticks >>= 1;
+		b++;
+	}
+	if (latency_hist[stage][b] != 0xFFFF) {
+		latency_hist[stage][b]++;
+	}
+}
+
+void
+latency_reset(void)
+{
+	memset(latency_hist, 0, sizeof(latency_hist));
+	tx_have_open = false;
+	tx_sending = false;
+	tx_probe_ready = false;
+	rx_draining = false;
+	rx_drained = false;
+	rx_have_probe = false;
+#ifdef INCLUDE_AES
+	rx_decrypts = 0;
+#endif
+	if (latency_enabled()) {
+		serial_rx_stamp_arm();
+	}
+}
+
+void
+latency_update(void)
+{
+	__pdata uint32_t total;
+
+	if (!latency_enabled()) {
+		return;
+	}
+
+	if (rx_draining && serial_write_drained(rx_mark)) {
+		rx_output = timer2_tick32() - rx_time;
+		rx_draining = false;
+		rx_drained = true;
+	}
+	if (rx_have_probe && !rx_draining) {
+		if (rx_drained && rx_probe.crc == rx_crc) {
+			total = rx_probe.window + rx_probe.queue +
+				rx_probe.packet + rx_probe.air + rx_output;
+			latency_record(LATENCY_WINDOW, rx_probe.window);
+			latency_record(LATENCY_QUEUE, rx_probe.queue);
+			latency_record(LATENCY_PACKET, rx_probe.packet);
+			latency_record(LATENCY_AIR, rx_probe.air);
+			latency_record(LATENCY_OUTPUT, rx_output);
+			latency_record(LATENCY_TOTAL, total);
+		}
+		// the probe is for a packet we lost, or one we have
+		// already used
+		rx_have_probe = false;
+		rx_drained = false;
+	}
+}
+
+void
+latency_tx_prepare(void)
+{
+	if (!latency_enabled()) {
+		return;
+	}
+	tx_prepare = timer2_tick32();
+	if (!tx_have_open && !tx_probe_ready && serial_rx_stamp_taken()) {
+		tx_open = tx_prepare;
+		tx_have_open = true;
+	}
+}
+
+void
+latency_tx_packet(__pdata uint8_t len, __xdata uint8_t * __pdata buf)
+{
+	if (!tx_have_open || !serial_rx_stamp_consumed()) {
+		return;
+	}
+	tx_have_open = false;
+	if (len == 0 || packet_is_resend() || packet_is_injected()) {
+		// the byte was dropped as stale. Try another one
+		serial_rx_stamp_arm();
+		return;
+	}
+	tx_probe.crc = crc16(len, buf);
+	tx_probe.window = tx_open - serial_rx_stamp_time();
+	tx_probe.queue = tx_prepare - tx_open;
+	tx_sending = true;
+}
+
+void
+latency_tx_start(void)
+{
+	if (tx_sending) {
+		tx_start = timer2_tick32();
+		tx_probe.packet = tx_start - tx_prepare;
+	}
+}
+
+void
+latency_tx_done(void)
+{
+	if (tx_sending) {
+		tx_probe.air = timer2_tick32() - tx_start;
+		tx_sending = false;
+		tx_probe_ready = true;
+	}
+}
+
+bool
+latency_probe_ready(void)
+{
+	return tx_probe_ready;
+}
+
+uint8_t
+latency_probe_build(__xdata uint8_t * __pdata buf)
+{
+	memcpy(buf, &tx_probe, sizeof(tx_probe));
+	tx_probe_ready = false;
+
+	// and start the next sample
+	serial_rx_stamp_arm();
+	return sizeof(tx_probe);
+}
+
+void
+latency_rx_packet(__pdata uint8_t len, __xdata uint8_t * __pdata buf)
+{
+	if (!latency_enabled()) {
+		return;
+	}
+	rx_crc = crc16(len, buf);
+	rx_time = timer2_tick32();
+	rx_draining = false;
+	rx_drained = false;
+#ifdef INCLUDE_AES
+	// an encrypted packet has only been queued, so its bytes reach
+	// the transmit ring once it has been decrypted
+	rx_decrypts = serial_decrypt_depth();
+	if (rx_decrypts != 0) {
+		return;
+	}
+#endif
+	rx_mark = serial_write_mark();
+	rx_draining = true;
+}
+
+#ifdef INCLUDE_AES
+void
+latency_rx_decrypted(bool written)
+{
+	if (rx_decrypts == 0 || --rx_decrypts != 0) {
+		return;
+	}
+	// the last user data packet is now in the transmit ring, unless
+	// it couldn't be decrypted
+	if (written) {
+		rx_mark = serial_write_mark();
+		rx_draining = true;
+	}
+}
+#endif // INCLUDE_AES
+
+void
+latency_rx_probe(__xdata uint8_t * __pdata buf)
+{
+	if (!latency_enabled()) {
+		return;
+	}
+	memcpy(&rx_probe, buf, sizeof(rx_probe));
+	rx_have_probe = true;
+}
+
+void
+latency_report(void)
+{
+	__pdata uint8_t s, b;
+
+	printf("ms< .13 .26 .51 1 2 4 8 16 33 66 131 262 524 1049 2097 +\n");
+	for (s = 0; s < LATENCY_STAGES; s++) {
+		printf("%s:", latency_name[s]);
+		for (b = 0; b < LATENCY_BUCKETS; b++) {
+			printf(" %u", (unsigned)latency_hist[s][b]);
+		}
+		printf("\n");
+	}
+}
+
+#endif // LATENCY_MEASURE
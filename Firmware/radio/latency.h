@@ -0,0 +1,145 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	latency.h
+///
+/// End to end latency measurement
+///
+/// With AT&T=LAT set on both radios, the sender timestamps one byte
+/// as the UART receives it, follows the air packet carrying it with a
+/// probe packet holding the time the byte spent in each stage on the
+/// sender, and the receiver adds the time until the byte has left its
+/// serial port. ATI8 on the receiver shows a histogram per stage.
+///
+/// The radios' timer2 clocks are not synchronised (the TDM sync only
+/// aligns the windows), so each stage is timed by one radio and only
+/// durations cross the link.
+///
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+// the histograms need more XRAM than the Si1000 boards have spare
+#ifdef CPU_SI1030
+#define LATENCY_MEASURE
+#endif
+
+#ifdef LATENCY_MEASURE
+
+/// the stages a byte goes through between the two serial ports
+enum latency_stage {
+	LATENCY_WINDOW = 0,	///< received until our transmit window opens
+	LATENCY_QUEUE,		///< behind other data in the serial buffer
+	LATENCY_PACKET,		///< building and loading the air packet
+	LATENCY_AIR,		///< on the air
+	LATENCY_OUTPUT,		///< in the receivers serial transmit buffer
+	LATENCY_TOTAL,		///< end to end
+	LATENCY_STAGES
+};
+
+/// probe packet sent after the sampled air packet. It is sent as a
+/// control packet (zero window) and told apart from statistics by
+/// its size. Times are in 16usec ticks
+struct latency_probe {
+	uint16_t crc;		///< crc16() of the sampled air packet
+	uint32_t window;
+	uint32_t queue;
+	uint16_t packet;
+	uint16_t air;
+};
+
+/// clear the histograms
+///
+extern void latency_reset(void);
+
+/// housekeeping, call this from the main loop
+///
+extern void latency_update(void);
+
+/// note a transmit opportunity, just before packet_get_next()
+///
+extern void latency_tx_prepare(void);
+
+/// note the packet returned by packet_get_next()
+///
+/// @param len			packet length
+/// @param buf			packet data
+///
+extern void latency_tx_packet(__pdata uint8_t len, __xdata uint8_t * __pdata buf);
+
+/// note the start of a transmission
+///
+extern void latency_tx_start(void);
+
+/// note the end of a transmission
+///
+extern void latency_tx_done(void);
+
+/// check if a probe packet is waiting to be sent
+///
+/// @return			true if latency_probe_build() should be called
+///
+extern bool latency_probe_ready(void);
+
+/// build the pending probe packet
+///
+/// @param buf			buffer for the probe
+/// @return			length of the probe
+///
+extern uint8_t latency_probe_build(__xdata uint8_t * __pdata buf);
+
+/// note a user data packet written to the serial port, or queued
+/// to be decrypted
+///
+/// @param len			packet length
+/// @param buf			packet data, as received
+///
+extern void latency_rx_packet(__pdata uint8_t len, __xdata uint8_t * __pdata buf);
+
+#ifdef INCLUDE_AES
+/// note a queued packet decrypted into the serial port
+///
+/// @param written		false if it couldn't be decrypted
+///
+extern void latency_rx_decrypted(bool written);
+#endif
+
+/// handle a received probe packet
+///
+/// @param buf			probe data
+///
+extern void latency_rx_probe(__xdata uint8_t * __pdata buf);
+
+/// display the histograms
+///
+extern void latency_report(void);
+
+#endif // LATENCY_MEASURE
+
+#endif // _LATENCY_H_
@@ -65,6 +65,10 @@ extern void	Receiver_ISR(void)	__interrupt(INTERRUPT_INT0);
 ///
 extern void    T2_ISR(void)     __interrupt(INTERRUPT_TIMER2);
 
+/// Timer0 wakeup interrupt handler
+///
+extern void    T0_ISR(void)     __interrupt(INTERRUPT_TIMER0);
+
 /// Timer3 tick interrupt handler
 ///
 /// @todo switch this and everything it calls to use another register bank?
@@ -97,7 +101,10 @@ __pdata struct statistics statistics, remote_statistics;
 
 /// optional features
 bool feature_golay;
+bool feature_golay_interleave;
+bool feature_rs;
 uint8_t feature_mavlink_framing;
+uint8_t feature_opportunistic_resend;
 bool feature_rtscts;
 
 void
@@ -120,7 +127,12 @@ main(void)
 
 	// setup boolean features
 	feature_mavlink_framing = param_get(PARAM_MAVLINK);
-	feature_golay = param_get(PARAM_ECC)?true:false;
+	feature_opportunistic_resend = param_get(PARAM_OPPRESEND);
+	feature_golay = (param_get(PARAM_ECC) == 1 || param_get(PARAM_ECC) == 2);
+	feature_golay_interleave = (param_get(PARAM_ECC) == 2);
+#ifdef INCLUDE_RS
+	feature_rs = (param_get(PARAM_ECC) == 3);
+#endif
 	feature_rtscts = param_get(PARAM_RTSCTS)?true:false;
 
 	// Do hardware initialisation.
@@ -255,8 +267,11 @@ hardware_init(void)
 	// UART - set the configured speed
 	serial_init(param_get(PARAM_SERIAL_SPEED));
 
-	// set all interrupts to the same priority level
+	// set all interrupts to the same priority level, except the
+	// UART. At 460800 and above the radio interrupt can take longer
+	// than a byte time, so the UART must be able to preempt it
 	IP = 0;
+	PS0 = 1;
 
 	// global interrupt enable
 	EA = 1;
@@ -37,7 +37,6 @@
 #include "packet.h"
 #include "timer.h"
 
-extern __xdata uint8_t pbuf[MAX_PACKET_LENGTH];
 static __pdata uint8_t seqnum;
 
 // new RADIO_STATUS common message
@@ -36,6 +36,7 @@
 #include "radio.h"
 #include "packet.h"
 #include "timer.h"
+#include "crc.h"
 
 #ifdef INCLUDE_AES
 #include "AES/aes.h"
@@ -43,7 +44,6 @@
 
 static __bit last_sent_is_resend;
 static __bit last_sent_is_injected;
-static __bit last_recv_is_resend;
 static __bit force_resend;
 
 static __xdata uint8_t last_received[MAX_PACKET_LENGTH];
@@ -66,14 +66,61 @@ static __pdata uint16_t mav_pkt_max_time;
 
 static __pdata uint8_t mav_max_xmit;
 
+// set while we hold back a serial frame that is still arriving, and
+// the timer2_tick time when we started holding it
+static __bit frame_waiting;
+static __pdata uint16_t frame_wait_start;
+
 // true if we have a injected packet to send
 static bool injected_packet;
 
 // have we seen a mavlink packet?
 bool seen_mavlink;
 
+// packets longer than this cost enough air time that they only get
+// one opportunistic resend, whatever the redundancy level
 #define PACKET_RESEND_THRESHOLD 32
 
+// opportunistic resends left for the last packet sent
+static __pdata uint8_t resend_left;
+
+#ifdef INCLUDE_ERASURE
+// XOR erasure coding. A data packet ends with a tag byte, its group
+// number in the top 4 bits and its index in the group below. After a
+// group the sender sends a parity packet, tagged ERASURE_PARITY. It
+// holds the XOR of the group's packets, zero padded to the longest,
+// then the XOR of their lengths and the number of packets
+#define ERASURE_PARITY 0x0F
+
+static __xdata uint8_t erasure_tx[MAX_PACKET_LENGTH];
+static __xdata uint8_t erasure_tx_len, erasure_tx_lens;
+static __xdata uint8_t erasure_tx_count, erasure_tx_group, erasure_tx_tag;
+
+static __xdata uint8_t erasure_rx[MAX_PACKET_LENGTH];
+static __xdata uint8_t erasure_rx_len, erasure_rx_lens, erasure_rx_group;
+static __xdata uint16_t erasure_rx_mask;
+static __bit erasure_rx_started;
+#endif // INCLUDE_ERASURE
+
+// age of the oldest queued serial byte, in msec
+__pdata uint16_t packet_sojourn;
+
+// CoDel state for the serial receive queue. While the oldest byte has
+// waited longer than half of MAX_DELAY for a whole interval we drop
+// frames from the head, more often the longer it goes on
+#define CODEL_INTERVAL	100	// msec
+static __pdata uint16_t codel_first_above;
+static __pdata uint16_t codel_drop_next;
+static __pdata uint8_t codel_count;
+static __bit codel_above;
+static __bit codel_dropping;
+
+// CODEL_INTERVAL / sqrt(count)
+static const __code uint8_t codel_spacing[] = {
+	100, 71, 58, 50, 45, 41, 38, 35, 33, 32, 30, 29, 28, 27, 26, 25
+};
+#define CODEL_SPACING(_n)	codel_spacing[(_n) < sizeof(codel_spacing) ? (_n)-1 : sizeof(codel_spacing)-1]
+
 // check if a buffer looks like a MAVLink heartbeat packet - this
 // is used to determine if we will inject RADIO status MAVLink
 // messages into the serial stream for ground station and aircraft
@@ -95,6 +142,38 @@ static void check_heartbeat(__xdata uint8_t * __pdata buf)
 #define MAVLINK_FRAMING_SIMPLE 1
 #define MAVLINK_FRAMING_HIGHPRI 2
 
+#ifdef INCLUDE_AES
+__xdata uint8_t len_encrypted;
+#endif // INCLUDE_AES
+
+// CRC16 of the bytes encryptReturn() last put in the packet buffer
+static __pdata uint16_t sent_crc;
+
+uint8_t encryptReturn(__xdata uint8_t *buf_out, __xdata uint8_t *buf_in, uint8_t buf_in_len)
+{
+#ifdef INCLUDE_AES
+  if (aes_get_encryption_level() > 0 && buf_in_len != 0) {
+    if (aes_encrypt(buf_in, buf_in_len, buf_out, &len_encrypted) != 0)
+    {
+      panic("error while trying to encrypt data");
+    }
+    sent_crc = crc16(len_encrypted, buf_out);
+    return len_encrypted;
+  }
+#else
+  if (!feature_golay && !feature_rs) {
+    // nothing wants the CRC
+    memcpy(buf_out, buf_in, buf_in_len);
+    return buf_in_len;
+  }
+#endif // INCLUDE_AES
+  
+  // if no encryption or not supported fall back to copy, taking
+  // the CRC on the way rather than reading the packet again for it
+  sent_crc = crc16_copy(buf_in_len, buf_out, buf_in, 0);
+  return buf_in_len;
+}
+
 // return a complete MAVLink frame, possibly expanding
 // to include other complete frames that fit in the max_xmit limit
 static 
@@ -114,7 +193,7 @@ uint8_t mavlink_frame(uint8_t max_xmit, __xdata uint8_t * __pdata buf)
                 register uint8_t extra_len = 8;
 		if (c != MAVLINK10_STX && c != MAVLINK20_STX) {
 			// its not a MAVLink packet
-			return last_sent_len;			
+			break;
 		}
                 if (c == MAVLINK20_STX) {
                         extra_len += 4;
@@ -140,36 +219,168 @@ uint8_t mavlink_frame(uint8_t max_xmit, __xdata uint8_t * __pdata buf)
 
                 // we can add another MAVLink frame to the packet
                 serial_read_buf(&last_sent[last_sent_len], c);
-                memcpy(&buf[last_sent_len], &last_sent[last_sent_len], c);
                 
-                check_heartbeat(buf+last_sent_len);
+                check_heartbeat(last_sent+last_sent_len);
                         
 		last_sent_len += c;
 		slen -= c;
 	}
 
-	return last_sent_len;
+	return encryptReturn(buf, last_sent, last_sent_len);
 }
 
-#ifdef INCLUDE_AES
-__xdata uint8_t len_encrypted;
-#endif // INCLUDE_AES
+// drop the oldest frame from the serial buffer. With MAVLink framing
+// that is a complete MAVLink packet, or any bytes before the next
+// one. With gap framing it is a whole frame, and otherwise it is the
+// bytes that arrived with the oldest byte
+static void
+packet_drop_frame(void)
+{
+	__pdata uint16_t n, slen;
+	register uint8_t c;
+
+	n = serial_read_chunk();
+	if (feature_mavlink_framing) {
+		slen = serial_read_available();
+		c = serial_peekx(0);
+		if ((c == MAVLINK10_STX || c == MAVLINK20_STX) && slen >= 3) {
+			n = serial_peekx(1) + 8;
+			if (c == MAVLINK20_STX) {
+				n += 4;
+				if (serial_peekx(2) & 1) {
+					// signed packet
+					n += 13;
+				}
+			}
+			if (n > slen) {
+				// incomplete, lose the lot
+				n = slen;
+			}
+		} else {
+			for (slen = 1; slen < n; slen++) {
+				c = serial_peekx(slen);
+				if (c == MAVLINK10_STX || c == MAVLINK20_STX) {
+					n = slen;
+					break;
+				}
+			}
+		}
+	} else if (param_get(PARAM_FRAME_GAP) != 0) {
+		slen = serial_read_frame();
+		if (slen != 0) {
+			n = slen;
+		}
+	}
+	serial_read_consume(n);
 
-uint8_t encryptReturn(__xdata uint8_t *buf_out, __xdata uint8_t *buf_in, uint8_t buf_in_len)
+	// any partial frame we were waiting for has gone
+	mav_pkt_len = 0;
+	frame_waiting = false;
+	if (errors.serial_rx_dropped != 0xFFFF) {
+		errors.serial_rx_dropped++;
+	}
+}
+
+// keep the time data waits in the serial buffer within MAX_DELAY
+static void
+packet_drop_stale(void)
 {
-#ifdef INCLUDE_AES
-  if (aes_get_encryption_level() > 0) {
-    if (aes_encrypt(buf_in, buf_in_len, buf_out, &len_encrypted) != 0)
-    {
-      panic("error while trying to encrypt data");
-    }
-    return len_encrypted;
-  }
-#endif // INCLUDE_AES
-  
-  // if no encryption or not supported fall back to copy
-  memcpy(buf_out, buf_in, buf_in_len);
-  return buf_in_len;
+	__pdata uint16_t max_delay, now;
+
+	packet_sojourn = serial_read_age();
+	max_delay = param_get(PARAM_MAX_DELAY);
+	if (max_delay == 0) {
+		return;
+	}
+
+	// nothing may wait longer than max_delay
+	while (packet_sojourn >= max_delay) {
+		packet_drop_frame();
+		packet_sojourn = serial_read_age();
+	}
+
+	// less than a packet queued is not a standing queue
+	if (packet_sojourn < max_delay/2 ||
+	    serial_read_available() < mav_max_xmit) {
+		codel_above = false;
+		codel_dropping = false;
+		return;
+	}
+
+	now = timer2_msec();
+	if (!codel_above) {
+		codel_above = true;
+		codel_first_above = now + CODEL_INTERVAL;
+	} else if (codel_dropping) {
+		if ((int16_t)(now - codel_drop_next) >= 0) {
+			packet_drop_frame();
+			if (codel_count != 0xFF) {
+				codel_count++;
+			}
+			codel_drop_next += CODEL_SPACING(codel_count);
+		}
+	} else if ((int16_t)(now - codel_first_above) >= 0) {
+		codel_dropping = true;
+		packet_drop_frame();
+		// carry on near the old drop rate if we only just stopped
+		if (codel_count > 2 &&
+		    (uint16_t)(now - codel_drop_next) < 16*CODEL_INTERVAL) {
+			codel_count -= 2;
+		} else {
+			codel_count = 1;
+		}
+		codel_drop_next = now + CODEL_SPACING(codel_count);
+	}
+}
+
+// return complete serial frames, as found from gaps in the serial
+// input, packing in as many as fit in max_xmit. A frame that is too
+// big for a packet is sent in pieces, and we only wait for the rest
+// of a frame for as long as a full packet would take to arrive
+static
+uint8_t gap_frame(uint8_t max_xmit, __xdata uint8_t * __pdata buf)
+{
+	__pdata uint16_t n;
+	__pdata uint32_t max_time;
+
+	n = serial_read_frame();
+	if (n == 0) {
+		// the frame is still arriving
+		n = serial_read_available();
+		if (n < max_xmit) {
+			if (!frame_waiting) {
+				frame_waiting = true;
+				frame_wait_start = timer2_tick();
+				return 0;
+			}
+			max_time = (uint32_t)mav_max_xmit * serial_rate;
+			if (max_time > 0xF000) {
+				// keep within the timer2_tick() wrap
+				max_time = 0xF000;
+			}
+			if ((uint16_t)(timer2_tick() - frame_wait_start) <= (uint16_t)max_time) {
+				return 0;
+			}
+		}
+	}
+	frame_waiting = false;
+
+	last_sent_len = 0;
+	while (n != 0 && n <= max_xmit - last_sent_len) {
+		serial_read_buf(&last_sent[last_sent_len], n);
+		last_sent_len += n;
+		n = serial_read_frame();
+	}
+	if (last_sent_len == 0) {
+		// a giant frame, or one that has timed out. Send as
+		// much as we can
+		if (n > max_xmit) {
+			n = max_xmit;
+		}
+		serial_read_buf(last_sent, n);
+		last_sent_len = n;
+	}
+	return encryptReturn(buf, last_sent, last_sent_len);
 }
 
 // return the next packet to be sent
@@ -179,13 +390,11 @@ packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf)
 	register uint16_t slen;
 
 #ifdef INCLUDE_AES
-  // Encryption takes 1 byte and is in multiples of 16.
-  // 16, 32, 48 etc, lets not send anything above 32 bytes back
-  // If you change this increase the buffer in serial.c serial_write_buf()
+  // max_xmit is the room for the cipher text, which can be bigger
+  // than the plain text
   if (aes_get_encryption_level() > 0) {
-    if(max_xmit <= 16) return 0;
-    if(max_xmit <= 32) max_xmit = 15;
-    if(max_xmit > 31 ) max_xmit = 31;
+    max_xmit = aes_plaintext_room(max_xmit);
+    if (max_xmit == 0) return 0;
   }
 #endif // INCLUDE_AES
   
@@ -216,6 +425,9 @@ packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf)
 
 	last_sent_is_injected = false;
 
+	// drop data that has waited too long to be useful
+	packet_drop_stale();
+
 	slen = serial_read_available();
 	if (force_resend) {
 		if (max_xmit < last_sent_len) {
@@ -223,6 +435,12 @@ packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf)
 		}
 		last_sent_is_resend = true;
 		force_resend = false;
+#ifdef INCLUDE_AES
+		// the same cipher text, so the receiver sees a duplicate
+		if (last_sent_len != 0) {
+			aes_repeat_nonce();
+		}
+#endif
 		return encryptReturn(buf, last_sent, last_sent_len);
 	}
 
@@ -234,18 +452,24 @@ packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf)
 		slen = max_xmit;
 	}
 
-	last_sent_len = 0;
-
 	if (slen == 0) {
-		// nothing available to send
+		// nothing available to send. last_sent is kept for
+		// packet_opportunistic_resend()
 		return 0;
 	}
 
+	last_sent_len = 0;
+	resend_left = feature_opportunistic_resend;
+
 	if (!feature_mavlink_framing) {
+		if (param_get(PARAM_FRAME_GAP) != 0) {
+			// whole frames, split by gaps in the input
+			return gap_frame(max_xmit, buf);
+		}
 		// simple framing
-		if (slen > 0 && serial_read_buf(buf, slen)) {
+		if (slen > 0 && serial_read_buf(last_sent, slen)) {
 			last_sent_len = slen;
-      return encryptReturn(last_sent, buf, slen);
+			return encryptReturn(buf, last_sent, slen);
 		}
     return 0;
 	}
@@ -340,7 +564,6 @@ packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf)
 				mav_pkt_max_time = mav_pkt_len * serial_rate;
 				return 0;					
 			} else {
-// TODO FIX THIS FOR ENCRYPT
 				// the whole packet is there
 				// and ready to be read
 				return mavlink_frame(max_xmit, buf);
@@ -353,6 +576,46 @@ packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf)
 	return encryptReturn(buf, last_sent, last_sent_len);
 }
 
+// send the last packet again while there is nothing new to send, up
+// to feature_opportunistic_resend times. The receiver drops the
+// copies it doesn't need as duplicates
+uint8_t
+packet_opportunistic_resend(uint8_t max_xmit, __xdata uint8_t *buf)
+{
+#ifdef INCLUDE_AES
+	if (aes_get_encryption_level() > 0) {
+		max_xmit = aes_plaintext_room(max_xmit);
+	}
+#endif // INCLUDE_AES
+
+	if (resend_left == 0 ||
+	    last_sent_len == 0 ||
+	    last_sent_len > max_xmit ||
+	    last_sent_is_injected ||
+	    injected_packet ||
+	    force_resend) {
+		return 0;
+	}
+	if (last_sent_len > PACKET_RESEND_THRESHOLD &&
+	    resend_left != feature_opportunistic_resend) {
+		return 0;
+	}
+	resend_left--;
+	last_sent_is_resend = true;
+#ifdef INCLUDE_AES
+	// the same cipher text, so the receiver sees a duplicate
+	aes_repeat_nonce();
+#endif
+	return encryptReturn(buf, last_sent, last_sent_len);
+}
+
+// return the CRC16 of the packet last returned
+uint16_t
+packet_crc(void)
+{
+	return sent_crc;
+}
+
 // return true if the packet currently being sent
 // is a resend
 bool 
@@ -380,12 +643,24 @@ packet_force_resend(void)
 void
 packet_set_max_xmit(uint8_t max)
 {
+#ifdef INCLUDE_ERASURE
+	// data packets leave room for the parity packet's extra bytes
+	if (param_get(PARAM_PARITY_GROUP) != 0) {
+		max -= PACKET_ERASURE_ROOM;
+	}
+#endif
+#ifdef INCLUDE_AES
+	// a MAVLink packet has to fit once encrypted
+	if (aes_get_encryption_level() > 0) {
+		max = aes_plaintext_room(max);
+	}
+#endif // INCLUDE_AES
 	mav_max_xmit = max;
 }
 
 // set the serial speed in bytes/s
 void
-packet_set_serial_speed(uint16_t speed)
+packet_set_serial_speed(uint32_t speed)
 {
 	// convert to 16usec/byte to match timer2_tick()
 	serial_rate = (65536UL / speed) + 1;
@@ -395,18 +670,12 @@ packet_set_serial_speed(uint16_t speed)
 bool 
 packet_is_duplicate(uint8_t len, __xdata uint8_t *buf, bool is_resend)
 {
-	if (!is_resend) {
-		memcpy(last_received, buf, len);
-		last_recv_len = len;
-		last_recv_is_resend = false;
-		return false;
-	}
-
-	// We are now looking at a packet with the resend bit set
-	if (last_recv_is_resend == false && 
-			len == last_recv_len &&
-			memcmp(last_received, buf, len) == 0) {
-		last_recv_is_resend = false;  // FIXME - this has no effect
+	// a packet with the resend bit set is a duplicate if it
+	// matches the last packet we took. Several resends of one
+	// packet can arrive, so a resend we take is remembered too
+	if (is_resend &&
+	    len == last_recv_len &&
+	    memcmp(last_received, buf, len) == 0) {
 		return true;
 	}
 #if 0
@@ -415,10 +684,163 @@ packet_is_duplicate(uint8_t len, __xdata uint8_t *buf, bool is_resend)
 	serial_write_buf(buf, len);
 	printf("]\r\n");
 #endif
-	last_recv_is_resend = true;
+	memcpy(last_received, buf, len);
+	last_recv_len = len;
 	return false;
 }
 
+#ifdef INCLUDE_ERASURE
+// XOR n bytes of src into dst
+static void
+erasure_xor(__xdata uint8_t * __data dst, __xdata uint8_t * __data src, __data uint8_t n)
+{
+	while (n--) {
+		*dst++ ^= *src++;
+	}
+}
+
+// start a new group to send
+static void
+erasure_tx_next(void)
+{
+	memset(erasure_tx, 0, erasure_tx_len);
+	erasure_tx_len = 0;
+	erasure_tx_lens = 0;
+	erasure_tx_count = 0;
+	erasure_tx_group = (erasure_tx_group + 1) & 0x0F;
+}
+
+// tag a data packet and add it to the open group's parity. A group
+// grows past PARAM_PARITY_GROUP packets while its parity doesn't fit
+// in the window, up to what the tag can count
+uint8_t
+packet_erasure_add(uint8_t len, __xdata uint8_t *buf)
+{
+	// a resend keeps the tag it had, and is already in the parity
+	if (!last_sent_is_resend) {
+		if (erasure_tx_count == ERASURE_PARITY) {
+			// give up on the parity for this group
+			erasure_tx_next();
+		}
+		erasure_xor(erasure_tx, buf, len);
+		if (len > erasure_tx_len) {
+			erasure_tx_len = len;
+		}
+		erasure_tx_lens ^= len;
+		erasure_tx_tag = (erasure_tx_group << 4) | erasure_tx_count;
+		erasure_tx_count++;
+	}
+	buf[len] = erasure_tx_tag;
+	return len + 1;
+}
+
+// build the parity packet for a full group, or any group if flushing,
+// and start the next group
+uint8_t
+packet_erasure_parity(uint8_t max_xmit, __xdata uint8_t *buf, bool flush)
+{
+	__pdata uint8_t len;
+
+	if (erasure_tx_count == 0 ||
+	    (erasure_tx_count < param_get(PARAM_PARITY_GROUP) && !flush) ||
+	    erasure_tx_len + 3 > max_xmit) {
+		return 0;
+	}
+	len = erasure_tx_len;
+	memcpy(buf, erasure_tx, len);
+	buf[len] = erasure_tx_lens;
+	buf[len+1] = erasure_tx_count;
+	buf[len+2] = (erasure_tx_group << 4) | ERASURE_PARITY;
+
+	erasure_tx_next();
+	last_sent_is_resend = false;
+	return len + 3;
+}
+
+// return true if a received packet is a parity packet
+bool
+packet_erasure_is_parity(uint8_t len, __xdata uint8_t *buf)
+{
+	return len != 0 && (buf[len-1] & 0x0F) == ERASURE_PARITY;
+}
+
+// note a received data packet in its group, or rebuild the one lost
+// packet of a group from its parity
+uint8_t
+packet_erasure_receive(uint8_t len, __xdata uint8_t *buf)
+{
+	__pdata uint8_t tag, group, index, count, missing, i;
+
+	tag = buf[--len];
+	group = tag >> 4;
+	index = tag & 0x0F;
+
+	if (!erasure_rx_started || group != erasure_rx_group) {
+		if (erasure_rx_started &&
+		    ((group - erasure_rx_group) & 0x0F) > 7) {
+			// a late resend from an earlier group
+			return index == ERASURE_PARITY ? 0 : len;
+		}
+		// the start of a new group
+		memset(erasure_rx, 0, erasure_rx_len);
+		erasure_rx_len = 0;
+		erasure_rx_lens = 0;
+		erasure_rx_mask = 0;
+		erasure_rx_group = group;
+		erasure_rx_started = true;
+	}
+
+	if (index != ERASURE_PARITY) {
+		if ((erasure_rx_mask & (1U << index)) == 0) {
+			erasure_xor(erasure_rx, buf, len);
+			if (len > erasure_rx_len) {
+				erasure_rx_len = len;
+			}
+			erasure_rx_lens ^= len;
+			erasure_rx_mask |= 1U << index;
+		}
+		return len;
+	}
+
+	// a parity packet. We can rebuild if exactly one packet
+	// of the group is missing
+	if (len < 2) {
+		return 0;
+	}
+	count = buf[len-1];
+	len -= 2;
+	if (count == 0 || count > ERASURE_PARITY ||
+	    erasure_rx_len > len ||
+	    (erasure_rx_mask >> count) != 0) {
+		return 0;
+	}
+	missing = 0xFF;
+	for (i = 0; i < count; i++) {
+		if ((erasure_rx_mask & (1U << i)) == 0) {
+			if (missing != 0xFF) {
+				// more than one lost
+				return 0;
+			}
+			missing = i;
+		}
+	}
+	if (missing == 0xFF) {
+		// nothing lost
+		return 0;
+	}
+	erasure_xor(buf, erasure_rx, erasure_rx_len);
+	count = buf[len] ^ erasure_rx_lens;
+	if (count > len) {
+		return 0;
+	}
+	erasure_rx_mask |= 1U << missing;
+	if (errors.rebuilt_packets != 0xFFFF) {
+		errors.rebuilt_packets++;
+	}
+	return count;
+}
+#endif // INCLUDE_ERASURE
+
 // inject a packet to send when possible
 void 
 packet_inject(__xdata uint8_t *buf, __pdata uint8_t len)
@@ -27,14 +27,44 @@
 //
 
 
+#ifdef INCLUDE_AES
+/// bytes of space before a packet to be sent. aes_encrypt() puts the
+/// CBC initial vector there, so it can encrypt in place in one pass
+#define PACKET_HEADROOM 16
+#else
+#define PACKET_HEADROOM 0
+#endif
+
+/// the TDM packet buffer, after its headroom
+extern __xdata uint8_t pbuf_space[PACKET_HEADROOM + MAX_PACKET_LENGTH];
+#define pbuf (&pbuf_space[PACKET_HEADROOM])
+
 /// return the next packet to be sent
 ///
 /// @param max_xmit		maximum bytes that can be sent
-/// @param buf			buffer to put bytes in
+/// @param buf			buffer to put bytes in, with PACKET_HEADROOM
+///				bytes before it that may be overwritten
 ///
 /// @return			number of bytes to send
 extern uint8_t packet_get_next(register uint8_t max_xmit, __xdata uint8_t *buf);
 
+/// return the last packet again, if it can have another opportunistic
+/// resend. Used when there is nothing new to send
+///
+/// @param max_xmit		maximum bytes that can be sent
+/// @param buf			buffer to put bytes in, as for packet_get_next()
+///
+/// @return			number of bytes to send, 0 for none
+extern uint8_t packet_opportunistic_resend(uint8_t max_xmit, __xdata uint8_t *buf);
+
+/// return the CRC16 of the last packet packet_get_next() or
+/// packet_opportunistic_resend() returned, as crc16() would give.
+/// It is taken as the packet is copied out, and is only kept up
+/// when AES is built in or golay or Reed-Solomon is on
+///
+/// @return			CRC16 of the packet
+extern uint16_t packet_crc(void);
+
 /// return true if the last packet was a resend
 ///
 /// @return			true is a resend
@@ -62,7 +92,53 @@ extern void packet_set_max_xmit(uint8_t max);
 ///
 /// @param  speed		serial speed bytes/s
 ///
-extern void packet_set_serial_speed(uint16_t speed);
+extern void packet_set_serial_speed(uint32_t speed);
+
+/// age of the oldest queued serial byte when the last packet was
+/// built, in msec
+extern __pdata uint16_t packet_sojourn;
+
+#ifdef INCLUDE_ERASURE
+/// bytes a data packet gives up so its group's parity packet fits
+#define PACKET_ERASURE_ROOM 3
+
+/// tag a data packet with its place in the open parity group, and add
+/// it to the group's parity, unless it is a resend
+///
+/// @param len			number of bytes in the packet
+/// @param buf			the packet, with room for the tag
+///
+/// @return			the length with the tag
+extern uint8_t packet_erasure_add(uint8_t len, __xdata uint8_t *buf);
+
+/// build the parity packet for the open group, if it is due
+///
+/// @param max_xmit		maximum bytes that can be sent
+/// @param buf			buffer to put bytes in
+/// @param flush		send parity for a group that is not yet full
+///
+/// @return			number of bytes to send, 0 for none
+extern uint8_t packet_erasure_parity(uint8_t max_xmit, __xdata uint8_t *buf, bool flush);
+
+/// return true if a received packet is a parity packet
+///
+/// @param len			number of bytes received
+/// @param buf			the packet
+///
+/// @return			true for a parity packet
+extern bool packet_erasure_is_parity(uint8_t len, __xdata uint8_t *buf);
+
+/// strip the tag from a received data packet and note it in its
+/// group. A parity packet is replaced with the one packet of its group
+/// that was lost, if there is one. Only call this for a packet that
+/// has passed its CRC and duplicate checks
+///
+/// @param len			number of bytes received
+/// @param buf			the packet
+///
+/// @return			number of data bytes now in buf, 0 for none
+extern uint8_t packet_erasure_receive(uint8_t len, __xdata uint8_t *buf);
+#endif // INCLUDE_ERASURE
 
 /// inject a packet to be sent when possible
 /// @param buf			buffer to send
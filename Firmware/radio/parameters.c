@@ -72,6 +72,11 @@ __code const struct parameter_info {
 	{"MAX_WINDOW",    131},
 #ifdef INCLUDE_AES
 	{"ENCRYPTION_LEVEL", 0}, // no Enycryption (0), 128 or 256 bit key
+#endif
+	{"MAX_DELAY",       0},
+	{"FRAME_GAP",       0},
+#ifdef INCLUDE_ERASURE
+	{"PARITY_GROUP",    0},
 #endif
 };
 
@@ -147,10 +152,19 @@ param_check(__pdata enum ParamID id, __data uint32_t val)
 			return false;
 		break;
 
-	case PARAM_ECC:
 	case PARAM_OPPRESEND:
-		// boolean 0/1 only
-		if (val > 1)
+		// copies of each packet sent in idle time
+		if (val > 3)
+			return false;
+		break;
+
+	case PARAM_ECC:
+		// 0 off, 1 golay, 2 interleaved golay, 3 Reed-Solomon
+#ifdef INCLUDE_RS
+		if (val > 3)
+#else
+		if (val > 2)
+#endif
 			return false;
 		break;
 
@@ -167,6 +181,34 @@ param_check(__pdata enum ParamID id, __data uint32_t val)
 			return false;
 		break;
 
+	case PARAM_MAX_DELAY:
+		// beyond this the receive buffer can't hold the data
+		// anyway, and timer2_msec() needs room to wrap
+		if (val > 10000)
+			return false;
+		break;
+
+	case PARAM_FRAME_GAP:
+		if (val > 100)
+			return false;
+		break;
+
+#ifdef INCLUDE_ERASURE
+	case PARAM_PARITY_GROUP:
+		// the index in a group has 4 bits, one value of which
+		// marks the parity packet
+		if (val == 1 || val > 15)
+			return false;
+		// a rebuilt packet arrives after the later packets of
+		// its group, which only framed data can put up with.
+		// In raw byte mode it would reorder the stream
+		if (val != 0 &&
+		    param_get(PARAM_MAVLINK) == 0 &&
+		    param_get(PARAM_FRAME_GAP) == 0)
+			return false;
+		break;
+#endif
+
 	default:
 		// no sanity check for this value
 		break;
@@ -181,6 +223,16 @@ param_set(__data enum ParamID param, __pdata param_t value)
 	if (!param_check(param, value))
 		return false;
 
+#ifdef INCLUDE_ERASURE
+	// parity groups need one of the two kinds of framing, so
+	// don't let the last one be turned off under them
+	if ((param == PARAM_MAVLINK || param == PARAM_FRAME_GAP) &&
+	    value == 0 &&
+	    param_get(PARAM_PARITY_GROUP) != 0 &&
+	    param_get(param == PARAM_MAVLINK ? PARAM_FRAME_GAP : PARAM_MAVLINK) == 0)
+		return false;
+#endif
+
 	// some parameters we update immediately
 	switch (param) {
 	case PARAM_TXPOWER:
@@ -210,6 +262,7 @@ param_set(__data enum ParamID param, __pdata param_t value)
 		break;
 
 	case PARAM_OPPRESEND:
+		feature_opportunistic_resend = value;
 		break;
 
 	case PARAM_RTSCTS:
@@ -217,6 +270,10 @@ param_set(__data enum ParamID param, __pdata param_t value)
 		value = feature_rtscts?1:0;
 		break;
 
+	case PARAM_FRAME_GAP:
+		serial_set_frame_gap(value);
+		break;
+
 	default:
 		break;
 	}
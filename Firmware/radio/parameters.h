@@ -51,9 +51,9 @@ enum ParamID {
 	PARAM_AIR_SPEED,		// over the air baud rate
 	PARAM_NETID,			// network ID
 	PARAM_TXPOWER,			// transmit power (dBm)
-	PARAM_ECC,				// ECC using golay encoding
+	PARAM_ECC,				// ECC, 1 golay, 2 interleaved golay, 3 Reed-Solomon
 	PARAM_MAVLINK,			// MAVLink framing, 0=ignore, 1=use, 2=rc-override
-	PARAM_OPPRESEND,		// opportunistic resend // DISABLED
+	PARAM_OPPRESEND,		// opportunistic resends of each packet in idle time, 0=off
 	PARAM_MIN_FREQ,			// min frequency in MHz
 	PARAM_MAX_FREQ,			// max frequency in MHz
 	PARAM_NUM_CHANNELS,		// number of hopping channels
@@ -64,6 +64,11 @@ enum ParamID {
 	PARAM_MAX_WINDOW,		// The maximum window size allowed
 #ifdef INCLUDE_AES
   PARAM_ENCRYPTION,     // no Enycryption (0), 128 or 256 bit key
+#endif
+	PARAM_MAX_DELAY,		// maximum serial queueing delay in msec, 0=unbounded
+	PARAM_FRAME_GAP,		// serial input gap that ends a frame in character times, 0=off
+#ifdef INCLUDE_ERASURE
+	PARAM_PARITY_GROUP,		// data packets per XOR parity packet, 0=off, needs MAVLINK or FRAME_GAP
 #endif
 	PARAM_MAX				// must be last
 };
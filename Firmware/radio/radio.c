@@ -33,6 +33,7 @@
 #include "radio.h"
 #include "timer.h"
 #include "golay.h"
+#include "rs.h"
 #include "crc.h"
 #include "pins_user.h"
 
@@ -47,6 +48,41 @@ static volatile __bit preamble_detected;
 
 __pdata struct radio_settings settings;
 
+#ifdef RFD900_DIVERSITY
+// software antenna diversity. The antenna is fixed for a whole TDM
+// round, and scored on the RSSI and packet success rate seen while
+// it was in use. Every DIVERSITY_PROBE_ROUNDS rounds the other antenna
+// is used for one round so its statistics don't go stale
+#define DIVERSITY_PROBE_ROUNDS 16
+#define DIVERSITY_HYSTERESIS   8
+
+static __bit diversity_software;
+static __bit diversity_probing;
+static __pdata uint8_t diversity_antenna;
+static __pdata uint8_t diversity_rounds;
+static __pdata uint8_t diversity_good;
+static __pdata uint16_t diversity_rx_errors;
+static __xdata uint8_t diversity_rssi[2];
+static __xdata uint8_t diversity_success[2];
+
+static void diversity_received(void);
+#endif // RFD900_DIVERSITY
+
+#ifdef INCLUDE_COMBINE
+// the last two damaged packets, for voting with a third damaged copy
+// of the same packet. combine_next is the free slot the next damaged
+// packet is kept in, followed by the oldest copy and then the newest
+static __xdata uint8_t combine_copy[3][MAX_PACKET_LENGTH];
+static __pdata uint8_t combine_len[3];
+static __pdata uint8_t combine_next;
+
+// the most bits a copy can differ from the new damaged packet by and
+// still be taken as the same packet, for n bytes. Copies of the same
+// packet only differ in their damage, while different packets differ
+// in about half their bits
+#define COMBINE_MAX_DISTANCE(n) (n)
+#endif // INCLUDE_COMBINE
+
 
 // internal helper functions
 //
@@ -70,6 +106,163 @@ static void	clear_status_registers(void);
 #define TX_FIFO_THRESHOLD_HIGH 60
 #define RX_FIFO_THRESHOLD_HIGH 50
 
+#if defined INCLUDE_GOLAY || defined INCLUDE_RS
+// the CRC of the next packet to send, if radio_transmit_crc() gave it
+static __pdata uint16_t transmit_crc;
+static __bit transmit_crc_known;
+
+// count the errors corrected in a received packet
+static void
+radio_count_corrected(__data uint8_t errcount)
+{
+	if (errcount != 0) {
+		if ((uint16_t)(0xFFFF - errcount) > errors.corrected_errors) {
+			errors.corrected_errors += errcount;
+		} else {
+			errors.corrected_errors = 0xFFFF;
+		}
+		if (errors.corrected_packets != 0xFFFF) {
+			errors.corrected_packets++;
+		}
+	}
+}
+#endif
+
+#ifdef INCLUDE_COMBINE
+// keep n bytes of a damaged packet in the free slot, before the
+// decoder changes them
+//
+static void
+radio_combine_keep(__data uint8_t n, __xdata uint8_t * __pdata buf)
+{
+	memcpy(combine_copy[combine_next], buf, n);
+	combine_len[combine_next] = n;
+}
+
+// vote bit by bit between the damaged packet last kept and the last
+// two damaged packets, into buf. A bit only wrong in one of the three
+// copies comes out right. Only copies of the same length that are
+// within COMBINE_MAX_DISTANCE() bits of the new packet are voted, so
+// unrelated packets aren't mixed. Either way the new packet replaces
+// the oldest copy, so a failed vote is retried with the next damaged
+// packet
+//
+// @return	    true if buf now holds the vote
+//
+static bool
+radio_combine(__xdata uint8_t * __pdata buf)
+{
+	__data uint8_t n = combine_len[combine_next];
+	__xdata uint8_t * __data copy = combine_copy[combine_next];
+	__data uint8_t o = combine_next == 2 ? 0 : combine_next+1;
+	__data uint8_t w = o == 2 ? 0 : o+1;
+	__xdata uint8_t * __data oldest = combine_copy[o];
+	__xdata uint8_t * __data newest = combine_copy[w];
+	__data uint8_t i, a, b, c, x;
+	__data uint16_t db, dc;
+	__data bool vote;
+
+	vote = (combine_len[o] == n && combine_len[w] == n);
+	if (vote) {
+		db = 0;
+		dc = 0;
+		for (i = 0; i < n; i++) {
+			a = copy[i];
+			b = oldest[i];
+			c = newest[i];
+			for (x = a ^ b; x != 0; x &= x - 1) {
+				db++;
+			}
+			for (x = a ^ c; x != 0; x &= x - 1) {
+				dc++;
+			}
+			buf[i] = (a & b) | (a & c) | (b & c);
+		}
+		vote = (db <= COMBINE_MAX_DISTANCE(n) &&
+			dc <= COMBINE_MAX_DISTANCE(n));
+	}
+
+	// the oldest slot is free for the next packet
+	combine_len[o] = 0;
+	combine_next = o;
+	return vote;
+}
+
+// a vote passed the CRC check, so its copies are used up
+static void
+radio_combined(void)
+{
+	combine_len[0] = 0;
+	combine_len[1] = 0;
+	combine_len[2] = 0;
+	if (errors.combined_packets != 0xFFFF) {
+		errors.combined_packets++;
+	}
+}
+#endif // INCLUDE_COMBINE
+
+#ifdef INCLUDE_RS
+// the payload length of a Reed-Solomon packet of n bytes
+//
+// @return	    the payload length, or 0xFF if no payload gives n
+//
+static uint8_t
+radio_rs_length(__data uint8_t n)
+{
+	__data uint8_t blocks, len;
+
+	blocks = RS_CODED_BLOCKS(n);
+	if (n < blocks*RS_PARITY + 5) {
+		return 0xFF;
+	}
+	len = n - blocks*RS_PARITY - 5;
+	if (RS_BLOCKS(len+5) != blocks) {
+		return 0xFF;
+	}
+	return len;
+}
+
+// check the network ID, length and CRC a Reed-Solomon packet carries
+// after its len byte payload, given the CRC of the payload
+//
+// @return	    true if the packet is good
+//
+static bool
+radio_check_rs(__data uint8_t len, __xdata uint8_t * __pdata buf, __data uint16_t crc)
+{
+	return buf[len] == netid[0] &&
+		buf[len+1] == netid[1] &&
+		buf[len+2] == len &&
+		crc == (buf[len+3] | (((uint16_t)buf[len+4])<<8));
+}
+
+// check a Reed-Solomon packet of n bytes with a len byte payload,
+// correcting it if needed. crc is the CRC of the payload as received
+//
+// @return	    true if the packet is good
+//
+static bool
+radio_decode_rs(__data uint8_t n, __data uint8_t len, __xdata uint8_t * __pdata buf, __data uint16_t crc)
+{
+	__data uint8_t errcount;
+
+	// the decoder only runs when the packet is damaged
+	if (!radio_check_rs(len, buf, crc)) {
+		errcount = rs_decode(n, buf);
+		if (errcount == 0xFF) {
+			debug("rs uncorrectable len=%u\n", (unsigned)n);
+			return false;
+		}
+		if (!radio_check_rs(len, buf, crc16(len, buf))) {
+			debug("rs check failed len=%u\n", (unsigned)n);
+			return false;
+		}
+		radio_count_corrected(errcount);
+	}
+	return true;
+}
+#endif // INCLUDE_RS
+
 // return a received packet
 //
 // returns true on success, false on no packet available
@@ -77,11 +270,18 @@ static void	clear_status_registers(void);
 bool
 radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 {
+#if defined INCLUDE_GOLAY || defined INCLUDE_RS
+	__data uint8_t elen;
+#endif
+#ifdef INCLUDE_RS
+	__pdata uint16_t crc;
+#endif
 #ifdef INCLUDE_GOLAY
+	__data uint8_t errcount = 0;
 	__xdata uint8_t gout[3];
 	__data uint16_t crc1, crc2;
-	__data uint8_t errcount = 0;
-	__data uint8_t elen;
+	__data uint8_t clen;
+	__pdata uint8_t groups, g;
 #endif
 
 	if (!packet_received) {
@@ -101,6 +301,51 @@ radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 	}
 #endif
   
+#ifdef INCLUDE_RS
+	if (feature_rs) {
+		// correct it in the callers buffer, after the receiver
+		// is listening for the next packet
+		elen = receive_packet_length;
+		*length = radio_rs_length(elen);
+		if (*length == 0xFF) {
+			radio_receiver_on();
+			debug("rs len invalid %u\n", (unsigned)elen);
+			goto failed;
+		}
+
+		// take the CRC of the payload as it is copied, so an
+		// undamaged packet isn't read again to check it
+		crc = crc16_copy(*length, buf, radio_buffer, 0);
+		memcpy(&buf[*length], &radio_buffer[*length], elen - *length);
+		radio_receiver_on();
+
+#ifdef INCLUDE_COMBINE
+		if (!radio_check_rs(*length, buf, crc)) {
+			// keep the coded bytes as received, as the
+			// decoder corrects them in place
+			radio_combine_keep(elen, buf);
+		}
+#endif
+		if (!radio_decode_rs(elen, *length, buf, crc)) {
+#ifdef INCLUDE_COMBINE
+			// the vote on the coded bytes may leave few
+			// enough errors for the decoder
+			if (!radio_combine(buf) ||
+			    !radio_decode_rs(elen, *length, buf, crc16(*length, buf))) {
+				goto failed;
+			}
+			radio_combined();
+#else
+			goto failed;
+#endif
+		}
+#ifdef RFD900_DIVERSITY
+		diversity_received();
+#endif
+		return true;
+	}
+#endif // INCLUDE_RS
+
 #ifdef INCLUDE_GOLAY
 	if (!feature_golay)
 #endif // INCLUDE_GOLAY
@@ -110,6 +355,9 @@ radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 
 		// simple unencoded packets
 		radio_receiver_on();
+#ifdef RFD900_DIVERSITY
+		diversity_received();
+#endif
 		return true;
 	}
 
@@ -117,11 +365,21 @@ radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 	// decode it in the callers buffer. This relies on the
 	// in-place decode properties of the golay code. Decoding in
 	// this way allows us to overlap decoding with the next receive
-	memcpy(buf, radio_buffer, receive_packet_length);
+	elen = receive_packet_length;
+	if (feature_golay_interleave && (elen%24) == 0) {
+		// gather the groups back into words as we copy, which
+		// must be done before radio_buffer is reused. The sender
+		// spent longer encoding than this takes
+		groups = elen / 24;
+		for (g = 0; g < groups; g++) {
+			golay_deinterleave(&radio_buffer[g], groups, &buf[g*24]);
+		}
+	} else {
+		memcpy(buf, radio_buffer, elen);
+	}
 
 	// enable the receiver for the next packet. This also
 	// enables the EX0 interrupt
-	elen = receive_packet_length;
 	radio_receiver_on();	
 
 	if (elen < 12 || (elen%6) != 0) {
@@ -141,7 +399,9 @@ radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 		goto failed;
 	}
 
-	if (6*((gout[2]+2)/3+2) != elen) {
+	// the coded length, less any interleave padding
+	clen = 6*((gout[2]+2)/3+2);
+	if ((feature_golay_interleave ? 24*GOLAY_INTERLEAVE_GROUPS(clen) : clen) != elen) {
 		debug("rx len mismatch1 %u %u\n",
 		       (unsigned)gout[2],
 		       (unsigned)elen);		
@@ -152,8 +412,8 @@ radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 	errcount += golay_decode(6, &buf[6], gout);
 	crc1 = gout[0] | (((uint16_t)gout[1])<<8);
 
-	if (elen != 12) {
-		errcount += golay_decode(elen-12, &buf[12], buf);
+	if (clen != 12) {
+		errcount += golay_decode(clen-12, &buf[12], buf);
 	}
 
 	*length = gout[2];
@@ -167,20 +427,30 @@ radio_receive_packet(uint8_t *length, __xdata uint8_t * __pdata buf)
 		       (unsigned)*length,
 		       (unsigned)buf[0],
 		       (unsigned)buf[1]);
-		goto failed;
-	}
-
-	if (errcount != 0) {
-		if ((uint16_t)(0xFFFF - errcount) > errors.corrected_errors) {
-			errors.corrected_errors += errcount;
-		} else {
-			errors.corrected_errors = 0xFFFF;
+#ifdef INCLUDE_COMBINE
+		// vote on the decoded bytes, where golay has already
+		// fixed what it could. The CRC gets a vote too
+		buf[*length] = crc1 & 0xFF;
+		buf[*length+1] = crc1 >> 8;
+		radio_combine_keep(*length+2, buf);
+		if (!radio_combine(buf)) {
+			goto failed;
 		}
-		if (errors.corrected_packets != 0xFFFF) {
-			errors.corrected_packets++;
+		crc1 = buf[*length] | (((uint16_t)buf[*length+1])<<8);
+		if (crc1 != crc16(*length, buf)) {
+			goto failed;
 		}
+		radio_combined();
+#else
+		goto failed;
+#endif
 	}
 
+	radio_count_corrected(errcount);
+
+#ifdef RFD900_DIVERSITY
+	diversity_received();
+#endif
   return true;
 #endif // INCLUDE_GOLAY
 
@@ -440,6 +710,51 @@ radio_transmit_simple(__data uint8_t length, __xdata uint8_t * __pdata buf, __pd
 }
 
 #ifdef INCLUDE_GOLAY
+// one group of 8 golay words before it is interleaved
+static __xdata uint8_t golay_group[24];
+
+// golay encode a packet into radio_buffer in groups of 8 words. The
+// bits of each group are interleaved so that every byte on air holds
+// one bit of each word in the group, and the groups are then
+// interleaved byte by byte. A burst of errors up to 3 bytes per group
+// long then costs each word at most 3 bits, which golay corrects
+//
+// @param head			6 bytes of header and CRC
+// @param rlen			payload length rounded to 3 bytes
+//
+// @return	    the number of bytes to send
+//
+static uint8_t
+radio_interleave_golay(__xdata uint8_t * __pdata head, __pdata uint8_t rlen, __xdata uint8_t * __pdata buf)
+{
+	__pdata uint8_t groups, g, u, k;
+
+	groups = GOLAY_INTERLEAVE_GROUPS((rlen+6)*2);
+	if (groups*24 > sizeof(radio_buffer)) {
+		debug("golay packet size %u\n", (unsigned)rlen);
+		panic("oversized golay packet");
+	}
+
+	// u counts the 3 byte units of data, each of which encodes
+	// to 2 words. The header and CRC are the first 2 units, and
+	// the last group is padded with zero words
+	u = 0;
+	for (g = 0; g < groups; g++) {
+		for (k = 0; k < 24; k += 6) {
+			if (u < 2) {
+				golay_encode(3, &head[u*3], &golay_group[k]);
+			} else if ((u-2)*3 < rlen) {
+				golay_encode(3, &buf[(u-2)*3], &golay_group[k]);
+			} else {
+				memset(&golay_group[k], 0, 6);
+			}
+			u++;
+		}
+		golay_interleave(golay_group, &radio_buffer[g], groups);
+	}
+	return groups*24;
+}
+
 // start transmitting a packet from the transmit FIFO
 //
 // @param length		number of data bytes to send
@@ -452,7 +767,7 @@ static bool
 radio_transmit_golay(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint16_t timeout_ticks)
 {
 	__pdata uint16_t crc;
-	__xdata uint8_t gin[3];
+	__xdata uint8_t gin[6];
 	__pdata uint8_t elen, rlen;
 
 	if (length > (sizeof(radio_buffer)/2)-6) {
@@ -471,18 +786,20 @@ radio_transmit_golay(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint
 	gin[1] = netid[1];
 	gin[2] = length;
 
-	// golay encode the header
-	golay_encode(3, gin, radio_buffer);
-
 	// next add a CRC, we round to 3 bytes for simplicity, adding 
 	// another copy of the length in the spare byte
-	crc = crc16(length, buf);
-	gin[0] = crc&0xFF;
-	gin[1] = crc>>8;
-	gin[2] = length;
+	crc = transmit_crc_known ? transmit_crc : crc16(length, buf);
+	gin[3] = crc&0xFF;
+	gin[4] = crc>>8;
+	gin[5] = length;
+
+	if (feature_golay_interleave) {
+		elen = radio_interleave_golay(gin, rlen, buf);
+		return radio_transmit_simple(elen, radio_buffer, timeout_ticks);
+	}
 
-	// golay encode the CRC
-	golay_encode(3, gin, &radio_buffer[6]);
+	// golay encode the header and CRC
+	golay_encode(6, gin, radio_buffer);
 
 	// encode the rest of the payload
 	golay_encode(rlen, buf, &radio_buffer[12]);
@@ -491,6 +808,48 @@ radio_transmit_golay(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint
 }
 #endif // INCLUDE_GOLAY
 
+#ifdef INCLUDE_RS
+// send a packet with Reed-Solomon parity. The network ID, length and
+// CRC follow the payload, so a received packet corrects in place
+// with the payload where the caller wants it
+//
+// @param length		number of data bytes to send
+// @param timeout_ticks		number of 16usec RTC ticks to allow
+//				for the send
+//
+// @return	    true if packet sent successfully
+//
+static bool
+radio_transmit_rs(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint16_t timeout_ticks)
+{
+	__pdata uint16_t crc;
+	__pdata uint8_t m;
+
+	m = length + 5;
+	if (length > sizeof(radio_buffer) - 5 ||
+	    m + RS_BLOCKS(m)*RS_PARITY > sizeof(radio_buffer)) {
+		debug("rs packet size %u\n", (unsigned)length);
+		panic("oversized rs packet");
+	}
+
+	if (transmit_crc_known) {
+		memcpy(radio_buffer, buf, length);
+		crc = transmit_crc;
+	} else {
+		crc = crc16_copy(length, radio_buffer, buf, 0);
+	}
+	radio_buffer[length] = netid[0];
+	radio_buffer[length+1] = netid[1];
+	radio_buffer[length+2] = length;
+	radio_buffer[length+3] = crc&0xFF;
+	radio_buffer[length+4] = crc>>8;
+
+	rs_encode(m, radio_buffer);
+
+	return radio_transmit_simple(m + RS_BLOCKS(m)*RS_PARITY, radio_buffer, timeout_ticks);
+}
+#endif // INCLUDE_RS
+
 // start transmitting a packet from the transmit FIFO
 //
 // @param length		number of data bytes to send
@@ -510,6 +869,11 @@ radio_transmit(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint16_t t
 	PA_ENABLE = 1;		// Set PA_Enable to turn on PA prior to TX cycle
 #endif
 
+#ifdef INCLUDE_RS
+	if (feature_rs) {
+		ret = radio_transmit_rs(length, buf, timeout_ticks);
+	} else
+#endif // INCLUDE_RS
 #ifdef INCLUDE_GOLAY
 	if (!feature_golay) {
 		ret = radio_transmit_simple(length, buf, timeout_ticks);
@@ -519,6 +883,9 @@ radio_transmit(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint16_t t
 #else
   ret = radio_transmit_simple(length, buf, timeout_ticks);
 #endif // INCLUDE_GOLAY
+#if defined INCLUDE_GOLAY || defined INCLUDE_RS
+	transmit_crc_known = false;
+#endif
   
 #if defined BOARD_rfd900a || defined BOARD_rfd900p
 	PA_ENABLE = 0;		// Set PA_Enable to off the PA after TX cycle
@@ -527,6 +894,16 @@ radio_transmit(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint16_t t
 	return ret;
 }
 
+// take the CRC of the next packet from the caller
+void
+radio_transmit_crc(__pdata uint16_t crc)
+{
+#if defined INCLUDE_GOLAY || defined INCLUDE_RS
+	transmit_crc = crc;
+	transmit_crc_known = true;
+#endif
+}
+
 
 // put the radio in receive mode
 //
@@ -758,7 +1135,10 @@ radio_configure(__pdata uint8_t air_rate)
 #elif ENABLE_RFD900_SWITCH
 	register_write(EZRADIOPRO_GPIO0_CONFIGURATION, 0x15);	// RX data (output)
 	register_write(EZRADIOPRO_GPIO1_CONFIGURATION, 0x12);	// RX data (output)
-#if RFD900_DIVERSITY
+#if RFD900_DIVERSITY == 2
+	// per TDM round antenna selection in software
+	radio_set_diversity(DIVERSITY_SOFTWARE);
+#elif RFD900_DIVERSITY
 	radio_set_diversity(DIVERSITY_ENABLED);
 #else
 	radio_set_diversity(DIVERSITY_DISABLED);
@@ -782,10 +1162,10 @@ radio_configure(__pdata uint8_t air_rate)
 	set_frequency_registers(settings.frequency);
 	register_write(EZRADIOPRO_FREQUENCY_HOPPING_STEP_SIZE, settings.channel_spacing);
 
-	if (feature_golay) {
-		// when using golay encoding we use our own crc16
-		// instead of the hardware CRC, as we need to correct
-		// bit errors before checking the CRC
+	if (feature_golay || feature_rs) {
+		// when using golay or Reed-Solomon encoding we use our
+		// own crc16 instead of the hardware CRC, as we need to
+		// correct errors before checking the CRC
 		register_write(EZRADIOPRO_DATA_ACCESS_CONTROL,
 			       EZRADIOPRO_ENPACTX | 
 			       EZRADIOPRO_ENPACRX);
@@ -814,9 +1194,7 @@ radio_configure(__pdata uint8_t air_rate)
 	register_write(EZRADIOPRO_TX_FIFO_CONTROL_2, TX_FIFO_THRESHOLD_LOW);
 	register_write(EZRADIOPRO_RX_FIFO_CONTROL, RX_FIFO_THRESHOLD_HIGH);
 
-	settings.preamble_length = 16;
-
-	register_write(EZRADIOPRO_PREAMBLE_LENGTH, settings.preamble_length); // nibbles 
+	radio_set_preamble_length(PREAMBLE_LENGTH_LONG);
 	register_write(EZRADIOPRO_PREAMBLE_DETECTION_CONTROL, 5<<3); // 5 nibbles
 
 	// setup minimum output power during startup
@@ -881,6 +1259,15 @@ radio_configure(__pdata uint8_t air_rate)
 	return true;
 }
 
+// set the transmit preamble length
+//
+void
+radio_set_preamble_length(uint8_t nibbles)
+{
+	settings.preamble_length = nibbles;
+	register_write(EZRADIOPRO_PREAMBLE_LENGTH, nibbles);
+}
+
 #ifdef BOARD_rfd900
 	#define NUM_POWER_LEVELS 5
 	__code static const uint8_t power_levels[NUM_POWER_LEVELS] = { 17, 20, 27, 29, 30 };
@@ -944,9 +1331,9 @@ radio_set_network_id(uint16_t id)
 {
 	netid[0] = id&0xFF;
 	netid[1] = id>>8;
-	if (!feature_golay) {
-		// when not using golay encoding we use the hardware
-		// headers for network ID
+	if (!feature_golay && !feature_rs) {
+		// when not using golay or Reed-Solomon encoding we use
+		// the hardware headers for network ID
 		register_write(EZRADIOPRO_TRANSMIT_HEADER_3, id >> 8);
 		register_write(EZRADIOPRO_TRANSMIT_HEADER_2, id & 0xFF);
 		register_write(EZRADIOPRO_CHECK_HEADER_3, id >> 8);
@@ -1163,11 +1550,32 @@ radio_temperature(void)
 	return temp_local;
 }
 
+/// fix the antenna switch on one antenna
+///
+/// @param ant2			true for antenna 2, false for antenna 1
+///
+static void
+radio_fixed_antenna(bool ant2)
+{
+  // see table 23.8, page 279
+  register_write(EZRADIOPRO_OPERATING_AND_FUNCTION_CONTROL_2, (register_read(EZRADIOPRO_OPERATING_AND_FUNCTION_CONTROL_2) & ~EZRADIOPRO_ANTDIV_MASK) | (ant2?0x20:0x00));
+  
+  register_write(EZRADIOPRO_GPIO2_CONFIGURATION, 0x0A);	// GPIO2 output set high fixed
+  if (ant2) {
+    register_write(EZRADIOPRO_IO_PORT_CONFIGURATION, 0x00);	// GPIO2 output set low (fixed on ant 2)
+  } else {
+    register_write(EZRADIOPRO_IO_PORT_CONFIGURATION, 0x04);	// GPIO2 output set high (fixed on ant 1)
+  }
+}
+
 /// Turn off radio diversity
 ///
 void
 radio_set_diversity(enum DIVERSITY_Enum state)
 {
+#ifdef RFD900_DIVERSITY
+  diversity_software = (state == DIVERSITY_SOFTWARE);
+#endif
   switch (state) {
     case DIVERSITY_ENABLED:
       register_write(EZRADIOPRO_GPIO2_CONFIGURATION, 0x18);
@@ -1176,25 +1584,119 @@ radio_set_diversity(enum DIVERSITY_Enum state)
       break;
       
     case DIVERSITY_ANT2:
-      // see table 23.8, page 279
-      register_write(EZRADIOPRO_OPERATING_AND_FUNCTION_CONTROL_2, (register_read(EZRADIOPRO_OPERATING_AND_FUNCTION_CONTROL_2) & ~EZRADIOPRO_ANTDIV_MASK) | 0x20);
-      
-      register_write(EZRADIOPRO_GPIO2_CONFIGURATION, 0x0A);	// GPIO2 output set high fixed
-      register_write(EZRADIOPRO_IO_PORT_CONFIGURATION, 0x00);	// GPIO2 output set low (fixed on ant 2)
+      radio_fixed_antenna(true);
       break;
       
+#ifdef RFD900_DIVERSITY
+    case DIVERSITY_SOFTWARE:
+      // start on antenna 1 with no history for either antenna
+      diversity_antenna = 0;
+      diversity_rounds = 0;
+      diversity_probing = false;
+      diversity_good = 0;
+      diversity_rx_errors = errors.rx_errors;
+      memset(diversity_rssi, 0, sizeof(diversity_rssi));
+      memset(diversity_success, 0x80, sizeof(diversity_success));
+      radio_fixed_antenna(false);
+      break;
+#endif // RFD900_DIVERSITY
+
     case DIVERSITY_DISABLED:
     case DIVERSITY_ANT1:
     default:
-      // see table 23.8, page 279
-      register_write(EZRADIOPRO_OPERATING_AND_FUNCTION_CONTROL_2, (register_read(EZRADIOPRO_OPERATING_AND_FUNCTION_CONTROL_2) & ~EZRADIOPRO_ANTDIV_MASK));
-      
-      register_write(EZRADIOPRO_GPIO2_CONFIGURATION, 0x0A);	// GPIO2 output set high fixed
-      register_write(EZRADIOPRO_IO_PORT_CONFIGURATION, 0x04);	// GPIO2 output set high (fixed on ant 1)
+      radio_fixed_antenna(false);
       break;
   }
 }
 
+#ifdef RFD900_DIVERSITY
+/// note a good packet on the current antenna
+///
+static void
+diversity_received(void)
+{
+  if (!diversity_software) {
+    return;
+  }
+  diversity_rssi[diversity_antenna] = (last_rssi + 3*(uint16_t)diversity_rssi[diversity_antenna])/4;
+  if (diversity_good != 0xFF) {
+    diversity_good++;
+  }
+}
+
+/// combined score for an antenna, higher is better
+///
+static uint16_t
+diversity_score(__pdata uint8_t ant)
+{
+  return (uint16_t)diversity_rssi[ant] + diversity_success[ant];
+}
+
+/// pick the antenna for the next TDM round
+///
+void
+radio_diversity_window(void)
+{
+  __pdata uint16_t bad;
+  __pdata uint8_t ant;
+
+  if (!diversity_software) {
+    return;
+  }
+
+  // fold the packet success rate for the round that has just
+  // finished into the score of the antenna we used for it
+  ant = diversity_antenna;
+  bad = errors.rx_errors - diversity_rx_errors;
+  if (bad > 0xFF - diversity_good) {
+    bad = 0xFF - diversity_good;
+  }
+  if (diversity_good != 0 || bad != 0) {
+    diversity_success[ant] = (((uint16_t)diversity_good * 255) / (diversity_good + bad) +
+                              3*(uint16_t)diversity_success[ant])/4;
+  }
+  diversity_good = 0;
+  diversity_rx_errors = errors.rx_errors;
+
+  if (diversity_probing) {
+    // the probe round is over, judge from the antenna we
+    // were using before it
+    diversity_probing = false;
+    ant ^= 1;
+  }
+
+  if (diversity_score(ant^1) > diversity_score(ant) + DIVERSITY_HYSTERESIS) {
+    // the other antenna is doing clearly better
+    ant ^= 1;
+    diversity_rounds = 0;
+  } else if (++diversity_rounds >= DIVERSITY_PROBE_ROUNDS) {
+    // re-probe the other antenna for one round
+    ant ^= 1;
+    diversity_rounds = 0;
+    diversity_probing = true;
+  }
+
+  if (ant != diversity_antenna) {
+    diversity_antenna = ant;
+    radio_fixed_antenna(ant != 0);
+  }
+}
+
+/// display the software diversity antenna statistics
+///
+void
+radio_diversity_report(void)
+{
+  printf("ANT: %u probe=%u RSSI: %u/%u success: %u/%u\n",
+         (unsigned)(diversity_software?diversity_antenna+1:0),
+         (unsigned)diversity_probing,
+         (unsigned)diversity_rssi[0],
+         (unsigned)diversity_rssi[1],
+         (unsigned)diversity_success[0],
+         (unsigned)diversity_success[1]);
+}
+#endif // RFD900_DIVERSITY
+
 /// the receiver interrupt
 ///
 /// We expect to get the following types of interrupt:
@@ -1232,7 +1734,7 @@ INTERRUPT(Receiver_ISR, INTERRUPT_INT0)
 		last_rssi = register_read(EZRADIOPRO_RECEIVED_SIGNAL_STRENGTH_INDICATOR);
 	}
 
-	if (feature_golay == false && (status & EZRADIOPRO_ICRCERROR)) {
+	if (feature_golay == false && feature_rs == false && (status & EZRADIOPRO_ICRCERROR)) {
 		goto rxfail;
 	}
 
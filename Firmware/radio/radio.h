@@ -69,7 +69,9 @@ extern __pdata uint8_t pdata_canary;
 
 /// optional features
 extern bool feature_golay;
-extern bool feature_opportunistic_resend;
+extern bool feature_golay_interleave;
+extern bool feature_rs;
+extern uint8_t feature_opportunistic_resend;
 extern uint8_t feature_mavlink_framing;
 extern bool feature_rtscts;
 
@@ -143,8 +145,16 @@ struct error_counts {
 	uint16_t serial_rx_overflow;    ///< count of serial receive overflows
 	uint16_t corrected_errors;      ///< count of words corrected by golay code
 	uint16_t corrected_packets;     ///< count of packets corrected by golay code
+	uint16_t serial_rx_dropped;	///< count of stale serial frames dropped
+#ifdef INCLUDE_ERASURE
+	uint16_t rebuilt_packets;	///< count of lost packets rebuilt from parity
+#endif
+#ifdef INCLUDE_COMBINE
+	uint16_t combined_packets;	///< count of packets voted from damaged copies
+#endif
 #ifdef INCLUDE_AES
 	uint16_t crc_errors;		///< count of crc errrors when AES in use>
+	uint16_t decrypt_errors;	///< count of packets that couldn't be decrypted
 #endif // INCLUDE_AES
 };
 __pdata extern struct error_counts errors;
@@ -174,6 +184,15 @@ extern bool radio_preamble_detected(void);
 ///
 extern bool radio_transmit(uint8_t length, __xdata uint8_t * __pdata buf, __pdata uint16_t timeout_ticks);
 
+/// give the CRC16 of the next packet, as crc16() would give, when the
+/// caller has it from building the packet. The golay and Reed-Solomon
+/// encodings then don't read the packet to find it. It only applies
+/// to the next radio_transmit()
+///
+/// @param crc			CRC16 of the whole packet
+///
+extern void radio_transmit_crc(__pdata uint16_t crc);
+
 /// switch the radio to receive mode
 ///
 /// @return			Always true.
@@ -285,6 +304,18 @@ struct radio_settings {
 
 extern __pdata struct radio_settings settings;
 
+// preamble lengths in nibbles. The long preamble is used for
+// acquisition, the short one once both radios are locked. The receiver
+// preamble detection threshold (5 nibbles) must be well below both
+#define PREAMBLE_LENGTH_LONG  16
+#define PREAMBLE_LENGTH_SHORT 10
+
+/// set the transmit preamble length
+///
+/// @param nibbles		preamble length in nibbles
+///
+extern void radio_set_preamble_length(uint8_t nibbles);
+
 /// return temperature in degrees C
 ///
 /// @return		temperature in degrees C, from 0 to 127
@@ -305,9 +336,21 @@ enum DIVERSITY_Enum
   DIVERSITY_ENABLED = 0,          // 0x00
   DIVERSITY_DISABLED,             // 0x01
   DIVERSITY_ANT1,                 // 0x02
-  DIVERSITY_ANT2                  // 0x03
+  DIVERSITY_ANT2,                 // 0x03
+  DIVERSITY_SOFTWARE              // 0x04
 };
 
 extern void radio_set_diversity(enum DIVERSITY_Enum state);
 
+#ifdef RFD900_DIVERSITY
+/// pick the antenna for the next TDM round when software
+/// diversity is enabled. Called at the start of each transmit window
+///
+extern void radio_diversity_window(void);
+
+/// display the software diversity antenna statistics
+///
+extern void radio_diversity_report(void);
+#endif // RFD900_DIVERSITY
+
 #endif // _RADIO_H_
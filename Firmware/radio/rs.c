@@ -0,0 +1,278 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	rs.c
+///
+/// shortened Reed-Solomon error correction over GF(256)
+///
+/// Each block is a codeword of the (255,247) code shortened to the
+/// block length, with generator roots alpha^0 .. alpha^7. Encoding is
+/// a table driven LFSR, two table lookups per byte per parity byte.
+/// Decoding only does syndromes unless a block has errors, then finds
+/// them with Berlekamp-Massey, a Chien search over the positions the
+/// block has, and Forney's formula
+///
+
+#include <stdarg.h>
+#include "radio.h"
+#include "rs.h"
+#include "rs_gf256.h"
+
+#ifdef INCLUDE_RS
+
+// the first parity byte of block b, for m message bytes in blocks
+// blocks. Byte k of the packet is always in block k % blocks, so a
+// burst over the end of the message is spread like any other
+#define RS_PARITY_START(m, blocks, b) ((m) + ((b) + (blocks) - (m) % (blocks)) % (blocks))
+
+// the block being decoded, its bytes are every rs_stride'th byte of
+// rs_buf from rs_b, rs_nb of message then RS_PARITY of parity
+static __xdata uint8_t * __pdata rs_buf;
+static __pdata uint8_t rs_m, rs_b, rs_stride, rs_nb;
+
+// polynomials for the decoder, lowest power first. They are in xdata
+// to leave pdata and the stack alone. The encoder keeps its remainder
+// in rs_syn, as encoding and decoding never overlap
+static __xdata uint8_t rs_syn[RS_PARITY];
+static __xdata uint8_t rs_lambda[RS_PARITY+1];
+static __xdata uint8_t rs_prev[RS_PARITY+1];
+static __xdata uint8_t rs_tmp[RS_PARITY+1];
+static __xdata uint8_t rs_omega[RS_PARITY/2];
+
+// a * b
+static uint8_t
+rs_mul(__data uint8_t a, __data uint8_t b)
+{
+	if (a == 0 || b == 0) {
+		return 0;
+	}
+	return rs_exp[rs_log[a] + rs_log[b]];
+}
+
+// the len coefficient polynomial p at alpha^lx, lx < 255
+static uint8_t
+rs_eval(__xdata uint8_t * __pdata p, __data uint8_t len, __data uint8_t lx)
+{
+	__data uint8_t v = 0;
+
+	while (len--) {
+		if (v != 0) {
+			v = rs_exp[rs_log[v] + lx];
+		}
+		v ^= p[len];
+	}
+	return v;
+}
+
+// byte j of the block being decoded
+static __xdata uint8_t *
+rs_byte(__data uint8_t j)
+{
+	if (j < rs_nb) {
+		return &rs_buf[rs_b + j*rs_stride];
+	}
+	return &rs_buf[RS_PARITY_START(rs_m, rs_stride, rs_b) + (j - rs_nb)*rs_stride];
+}
+
+void
+rs_encode(__pdata uint8_t m, __xdata uint8_t * __pdata buf)
+{
+	__xdata uint8_t * __data p;
+	__pdata uint8_t blocks, b, k;
+	__data uint8_t fb, lf, i;
+
+	blocks = RS_BLOCKS(m);
+	for (b = 0; b < blocks; b++) {
+		memset(rs_syn, 0, sizeof(rs_syn));
+		for (k = b; k < m; k += blocks) {
+			// shift the remainder, subtracting fb times the
+			// generator
+			fb = buf[k] ^ rs_syn[0];
+			if (fb == 0) {
+				for (i = 0; i < RS_PARITY-1; i++) {
+					rs_syn[i] = rs_syn[i+1];
+				}
+				rs_syn[RS_PARITY-1] = 0;
+				continue;
+			}
+			lf = rs_log[fb];
+			for (i = 0; i < RS_PARITY-1; i++) {
+				rs_syn[i] = rs_syn[i+1] ^ rs_exp[lf + rs_genlog[i]];
+			}
+			rs_syn[RS_PARITY-1] = rs_exp[lf + rs_genlog[RS_PARITY-1]];
+		}
+		p = &buf[RS_PARITY_START(m, blocks, b)];
+		for (i = 0; i < RS_PARITY; i++) {
+			*p = rs_syn[i];
+			p += blocks;
+		}
+	}
+}
+
+// correct the block described by rs_buf etc, returning the number of
+// bytes corrected or 0xFF
+static uint8_t
+rs_decode_block(void)
+{
+	__xdata uint8_t * __data p;
+	__data uint8_t c, i, j, n, d, len, shift;
+	__pdata uint8_t lx, lo, ld, found;
+
+	// syndromes, the received word at alpha^i
+	memset(rs_syn, 0, sizeof(rs_syn));
+	n = rs_nb + RS_PARITY;
+	d = 0;
+	p = rs_byte(0);
+	for (j = 0; j < n; j++) {
+		if (j == rs_nb) {
+			p = rs_byte(j);
+		}
+		c = *p;
+		p += rs_stride;
+		for (i = 0; i < RS_PARITY; i++) {
+			if (rs_syn[i] != 0) {
+				rs_syn[i] = rs_exp[rs_log[rs_syn[i]] + i];
+			}
+			rs_syn[i] ^= c;
+		}
+	}
+	for (i = 0; i < RS_PARITY; i++) {
+		d |= rs_syn[i];
+	}
+	if (d == 0) {
+		return 0;
+	}
+
+	// Berlekamp-Massey for the error locator rs_lambda, of
+	// degree len
+	memset(rs_lambda, 0, sizeof(rs_lambda));
+	memset(rs_prev, 0, sizeof(rs_prev));
+	rs_lambda[0] = 1;
+	rs_prev[0] = 1;
+	len = 0;
+	shift = 1;
+	lo = 0;		// log of the last non-zero discrepancy, 1
+	for (n = 0; n < RS_PARITY; n++) {
+		d = rs_syn[n];
+		for (i = 1; i <= len; i++) {
+			d ^= rs_mul(rs_lambda[i], rs_syn[n-i]);
+		}
+		if (d == 0) {
+			shift++;
+			continue;
+		}
+		// lambda -= d/last * x^shift * prev
+		ld = (rs_log[d] + 255 - lo) % 255;
+		memcpy(rs_tmp, rs_lambda, sizeof(rs_tmp));
+		for (i = shift; i <= RS_PARITY; i++) {
+			if (rs_prev[i-shift] != 0) {
+				rs_lambda[i] ^= rs_exp[ld + rs_log[rs_prev[i-shift]]];
+			}
+		}
+		if (2*len <= n) {
+			len = n + 1 - len;
+			memcpy(rs_prev, rs_tmp, sizeof(rs_prev));
+			lo = rs_log[d];
+			shift = 1;
+		} else {
+			shift++;
+		}
+	}
+	if (len == 0 || len > RS_PARITY/2) {
+		return 0xFF;
+	}
+
+	// the error evaluator, syndromes times lambda mod x^len
+	for (i = 0; i < len; i++) {
+		d = 0;
+		for (j = 0; j <= i; j++) {
+			d ^= rs_mul(rs_syn[i-j], rs_lambda[j]);
+		}
+		rs_omega[i] = d;
+	}
+
+	// lambda' for Forney, in rs_tmp
+	for (i = 0; i < len; i++) {
+		rs_tmp[i] = (i & 1) ? 0 : rs_lambda[i+1];
+	}
+
+	// Chien search. Byte j is the coefficient of x^(n-1-j), and
+	// is in error if lambda has a root at alpha^-(n-1-j)
+	n = rs_nb + RS_PARITY;
+	found = 0;
+	for (j = 0; j < n; j++) {
+		c = n - 1 - j;
+		lx = c ? 255 - c : 0;
+		if (rs_eval(rs_lambda, len+1, lx) != 0) {
+			continue;
+		}
+		// Forney, the error is X omega(1/X) / lambda'(1/X)
+		// for X = alpha^c
+		d = rs_eval(rs_tmp, len, lx);
+		if (d == 0) {
+			return 0xFF;
+		}
+		ld = rs_log[d];
+		d = rs_eval(rs_omega, len, lx);
+		if (d != 0) {
+			*rs_byte(j) ^= rs_exp[((uint16_t)c + rs_log[d] + 255 - ld) % 255];
+		}
+		found++;
+	}
+	if (found != len) {
+		// some roots are outside the shortened block
+		return 0xFF;
+	}
+	return found;
+}
+
+uint8_t
+rs_decode(__pdata uint8_t n, __xdata uint8_t * __pdata buf)
+{
+	__pdata uint8_t count, ret;
+
+	rs_stride = RS_CODED_BLOCKS(n);
+	if (n <= rs_stride*RS_PARITY) {
+		return 0xFF;
+	}
+	rs_m = n - rs_stride*RS_PARITY;
+	rs_buf = buf;
+	count = 0;
+	for (rs_b = 0; rs_b < rs_stride; rs_b++) {
+		rs_nb = (rs_m - rs_b + rs_stride - 1) / rs_stride;
+		ret = rs_decode_block();
+		if (ret == 0xFF) {
+			return 0xFF;
+		}
+		count += ret;
+	}
+	return count;
+}
+
+#endif // INCLUDE_RS
@@ -0,0 +1,65 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	rs.h
+///
+/// shortened Reed-Solomon error correction over GF(256)
+///
+/// A message of m bytes gets RS_PARITY parity bytes for each of
+/// RS_BLOCKS(m) blocks, following the message. Byte k of the packet
+/// is in block k % RS_BLOCKS(m). Each block corrects up to
+/// RS_PARITY/2 bytes in error, so a burst of up to RS_PARITY/2 bytes
+/// per block is corrected
+///
+
+#ifndef _RS_H_
+#define _RS_H_
+
+#ifdef INCLUDE_RS
+/// parity bytes per block
+#define RS_PARITY 8
+
+/// the most message bytes in one block, giving 14% parity
+#define RS_BLOCK 56
+
+/// the number of blocks for a message of m bytes
+#define RS_BLOCKS(m) (((m) + RS_BLOCK - 1) / RS_BLOCK)
+
+/// the number of blocks in n coded bytes
+#define RS_CODED_BLOCKS(n) (((n) + RS_BLOCK + RS_PARITY - 1) / (RS_BLOCK + RS_PARITY))
+
+/// add parity for the m byte message in buf, writing it at buf[m]
+extern void rs_encode(__pdata uint8_t m, __xdata uint8_t * __pdata buf);
+
+/// correct the n coded bytes in buf in place. Returns the number of
+/// bytes corrected, or 0xFF if a block has too many errors to correct
+extern uint8_t rs_decode(__pdata uint8_t n, __xdata uint8_t * __pdata buf);
+#endif // INCLUDE_RS
+
+#endif // _RS_H_
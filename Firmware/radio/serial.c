@@ -35,6 +35,8 @@
 
 #include "serial.h"
 #include "packet.h"
+#include "timer.h"
+#include "latency.h"
 
 #ifdef CPU_SI1030
 #include "AES/aes.h"
@@ -48,30 +50,117 @@
 // would be about 16x larger than the largest air packet if we have
 // 8 TDM time slots
 //
+// The rx and tx rings, and the AES decrypt queue, are regions of one
+// arena. rx is at the bottom, tx is at the top of the space left for
+// the rings and the decrypt queue takes the top when encryption is
+// enabled (otherwise rx gets that space). RX_BUFF_MAX and TX_BUFF_MAX
+// are the initial split. When one ring is getting full and the other
+// is empty the busy ring doubles in size, halving the other if it has
+// to, but never taking it below its minimum.
+//
+// Both rings are always a power of two in size, so wrapping an index
+// is a mask rather than a compare or a 16 bit modulus
+//
 
 #ifdef CPU_SI1030
 #define RX_BUFF_MAX 1024 //2048
 #define TX_BUFF_MAX 1024
-#define ENCRYPT_BUFF_MAX 17*60 // 16 bit encrypted packets plus one for size
-static __pdata uint16_t encrypt_buff_start = 400; // Start decrypting more to clear buffer
-static __pdata uint16_t encrypt_buff_end = 500; // End our quick buffer clear
+#define ENCRYPT_BUFF_MAX 1024 // 60 16 byte encrypted packets, each with a size byte
 #else
-#define RX_BUFF_MAX 1850
-#define TX_BUFF_MAX 645
+#define RX_BUFF_MAX 2048
+#define TX_BUFF_MAX 512
 #endif // CPU_SI1030
 
-__xdata uint8_t rx_buf[RX_BUFF_MAX] = {0};
-__xdata uint8_t tx_buf[TX_BUFF_MAX] = {0};
+// guaranteed ring sizes. Both must hold a full air packet
+#define RX_BUFF_MIN 512
+#define TX_BUFF_MIN 256
+
+#if (RX_BUFF_MAX & (RX_BUFF_MAX-1)) || (TX_BUFF_MAX & (TX_BUFF_MAX-1))
+#error serial buffer sizes must be a power of two
+#endif
+
+#ifdef INCLUDE_AES
+#if ((RX_BUFF_MAX + ENCRYPT_BUFF_MAX) & (RX_BUFF_MAX + ENCRYPT_BUFF_MAX - 1))
+#error rx must stay a power of two when it takes the decrypt queue space
+#endif
+#define ARENA_SIZE (RX_BUFF_MAX + TX_BUFF_MAX + ENCRYPT_BUFF_MAX)
+#define RING_AREA() (ARENA_SIZE - encrypt_size)
+#else
+#define ARENA_SIZE (RX_BUFF_MAX + TX_BUFF_MAX)
+#define RING_AREA() ARENA_SIZE
+#endif
+
+static __xdata uint8_t serial_arena[ARENA_SIZE];
+#define rx_buf serial_arena
+static __xdata uint8_t * volatile __pdata tx_buf;
 #ifdef INCLUDE_AES
-__xdata uint8_t encrypt_buf[ENCRYPT_BUFF_MAX] = {0};
+static __xdata uint8_t * __pdata encrypt_buf;
+static __pdata uint16_t encrypt_size;
 #endif // INCLUDE_AES
+
+// ring sizes, always powers of two
+static volatile __pdata uint16_t				rx_size, tx_size;
+
 // FIFO insert/remove pointers
 static volatile __pdata uint16_t				rx_insert, rx_remove;
 static volatile __pdata uint16_t				tx_insert, tx_remove;
 #ifdef CPU_SI1030
 static volatile __pdata uint16_t				encrypt_insert, encrypt_remove;
+
+// packets waiting in the decrypt queue, and the most since last asked
+static __pdata uint16_t					decrypt_queued, decrypt_queued_peak;
 #endif
 
+// arrival time marks for the receive ring, used to bound the age of
+// queued data. A mark says that every byte before rx_mark_pos[] had
+// arrived by rx_mark_time[]. Positions count the bytes received since
+// serial_init() and wrap, so only differences between them mean
+// anything. The oldest mark is first.
+#define RX_MARKS		8
+#define RX_MARK_SPACING		4	// minimum msec between marks
+#define RX_MARK_AGE_MAX		0x8000	// msec, well short of the timer2_msec() wrap
+static __xdata uint16_t		rx_mark_pos[RX_MARKS];
+static __xdata uint16_t		rx_mark_time[RX_MARKS];
+static __pdata uint8_t		rx_marks;
+static __pdata uint16_t		rx_consumed;
+
+// frame boundaries found from gaps in the serial input. The interrupt
+// queues the receive position of the first byte of each frame. Gaps
+// are timed with timer2 (SYSCLK/12), with serial_rx_idle covering the
+// gaps that are long enough for timer2 to wrap. The threshold is at
+// most FRAME_GAP_MAX counts (about 30ms)
+#define RX_FRAMES		8
+#define RX_FRAMES_MASK		(RX_FRAMES - 1)
+#define FRAME_GAP_MAX		60000U
+static __xdata uint16_t			rx_frame_start[RX_FRAMES];
+static volatile __pdata uint8_t		rx_frame_insert, rx_frame_remove;
+static volatile __pdata uint16_t	rx_last_byte;
+static __pdata uint16_t			frame_gap;	// timer2 counts, 0 = off
+static __pdata uint8_t			frame_gap_chars;
+static __pdata uint16_t			char_counts;	// timer2 counts per character
+
+#ifdef LATENCY_MEASURE
+// ingress timestamp of one received byte, for latency measurement.
+// rx_stamp_pos is the receive position just after the byte
+static volatile __bit			rx_stamp_armed;
+static volatile __bit			rx_stamp_valid;
+static __pdata uint16_t			rx_stamp_pos;
+static __pdata uint16_t			rx_stamp_high, rx_stamp_low;
+
+// bytes written to the transmit ring since serial_init()
+static __pdata uint16_t			tx_written;
+#endif // LATENCY_MEASURE
+
+// +++ escape detection. The UART interrupt counts the '+' that start
+// a burst of input after a guard time of silence, whether or not
+// there is room for them in the rx ring, and serial_escape_detect()
+// checks the guard time after them from the main loop
+__data volatile uint8_t serial_rx_idle;
+volatile __bit serial_rx_seen;
+static volatile __pdata uint8_t		escape_count;
+static volatile __bit			escape_armed;
+static volatile __bit			escape_dirty;
+
 // count of number of bytes we are allowed to send due to a RTS low reading
 static uint8_t rts_count;
 
@@ -79,14 +168,15 @@ static uint8_t rts_count;
 static volatile bool			tx_idle;
 
 // FIFO status
-#define BUF_NEXT_INSERT(_b)	((_b##_insert + 1) == sizeof(_b##_buf)?0:(_b##_insert + 1))
-#define BUF_NEXT_REMOVE(_b)	((_b##_remove + 1) == sizeof(_b##_buf)?0:(_b##_remove + 1))
+#define BUF_MASK(_b)	(_b##_size - 1)
+#define BUF_NEXT_INSERT(_b)	((_b##_insert + 1) & BUF_MASK(_b))
+#define BUF_NEXT_REMOVE(_b)	((_b##_remove + 1) & BUF_MASK(_b))
 #define BUF_FULL(_b)	(BUF_NEXT_INSERT(_b) == (_b##_remove))
 #define BUF_NOT_FULL(_b)	(BUF_NEXT_INSERT(_b) != (_b##_remove))
 #define BUF_EMPTY(_b)	(_b##_insert == _b##_remove)
 #define BUF_NOT_EMPTY(_b)	(_b##_insert != _b##_remove)
-#define BUF_USED(_b)	((_b##_insert >= _b##_remove)?(_b##_insert - _b##_remove):(sizeof(_b##_buf) - _b##_remove) + _b##_insert)
-#define BUF_FREE(_b)	((_b##_insert >= _b##_remove)?(sizeof(_b##_buf) + _b##_remove - _b##_insert):_b##_remove - _b##_insert)
+#define BUF_USED(_b)	((_b##_insert - _b##_remove) & BUF_MASK(_b))
+#define BUF_FREE(_b)	((_b##_remove - _b##_insert - 1) & BUF_MASK(_b))
 
 // FIFO insert/remove operations
 //
@@ -101,11 +191,20 @@ static volatile bool			tx_idle;
 		_b##_remove = BUF_NEXT_REMOVE(_b); } while(0)
 #define BUF_PEEK(_b)	_b##_buf[_b##_remove]
 #define BUF_PEEK2(_b)	_b##_buf[BUF_NEXT_REMOVE(_b)]
-#define BUF_PEEKX(_b, offset)	_b##_buf[(_b##_remove+offset) % sizeof(_b##_buf)]
+#define BUF_PEEKX(_b, offset)	_b##_buf[(_b##_remove+offset) & BUF_MASK(_b)]
+
+// advance a ring index by n bytes
+#define BUF_ADVANCE(_b, _i, _n)	do { _i = (_i + (_n)) & BUF_MASK(_b); } while(0)
+
+#ifdef INCLUDE_AES
+// the encrypt buffer holds whole length prefixed packets which never
+// wrap, so it isn't managed like the serial rings
+#define ENCRYPT_BUF_FREE()	((encrypt_insert >= encrypt_remove)?(encrypt_size + encrypt_remove - encrypt_insert):encrypt_remove - encrypt_insert)
+#endif // INCLUDE_AES
 
 static void			_serial_write(register uint8_t c);
 static void			serial_restart(void);
-static void serial_device_set_speed(register uint8_t speed);
+static void serial_device_set_speed(register uint16_t speed);
 
 // save and restore serial interrupt. We use this rather than
 // __critical to ensure we don't disturb the timer interrupt at all.
@@ -120,13 +219,15 @@ static void serial_device_set_speed(register uint8_t speed);
 void
 serial_interrupt(void) __interrupt(INTERRUPT_UART0)
 {
-	register uint8_t	c;
+	register uint8_t	c, idle;
+	register uint16_t	next, now;
 
 	// check for received byte first
 	if (RI0) {
 		// acknowledge interrupt and fetch the byte immediately
 		RI0 = 0;
 		c = SBUF0;
+		idle = SERIAL_RX_IDLE();
 
 		// if AT mode is active, the AT processor owns the byte
 		if (at_mode_active) {
@@ -135,19 +236,72 @@ serial_interrupt(void) __interrupt(INTERRUPT_UART0)
 				at_input(c);
 			}
 		} else {
-			// run the byte past the +++ detector
-			at_plus_detector(c);
+			// count the '+' of a burst after a guard time, for
+			// the +++ detector. Any other byte, or a fourth
+			// '+', cancels it
+			if (!escape_armed && idle >= SERIAL_ESCAPE_GUARD) {
+				escape_count = 0;
+				escape_armed = true;
+			}
+			if (escape_armed) {
+				if (c != (uint8_t)'+' || escape_count == 3) {
+					escape_armed = false;
+				} else {
+					escape_count++;
+				}
+			}
+			serial_rx_seen = true;
+			escape_dirty = true;
+
+			// note the start of a frame after a gap
+			if (frame_gap != 0) {
+				do {
+					next = TMR2H;
+					now = TMR2L;
+				} while (next != TMR2H);
+				now |= next << 8;
+				if (idle >= 3 || (uint16_t)(now - rx_last_byte) >= frame_gap) {
+					next = (rx_frame_insert + 1) & RX_FRAMES_MASK;
+					if (next != rx_frame_remove) {
+						rx_frame_start[rx_frame_insert] = rx_consumed + BUF_USED(rx);
+						rx_frame_insert = next;
+					}
+				}
+				rx_last_byte = now;
+			}
 
-			// and queue it for general reception
-			if (BUF_NOT_FULL(rx)) {
-				BUF_INSERT(rx, c);
+			// and queue it for general reception. At 921600 we
+			// have under 11usec per byte, so only work out the
+			// next insert point once
+			next = BUF_NEXT_INSERT(rx);
+			if (next != rx_remove) {
+				rx_buf[rx_insert] = c;
+				rx_insert = next;
+#ifdef LATENCY_MEASURE
+				if (rx_stamp_armed) {
+					do {
+						c = TMR2H;
+						rx_stamp_low = TMR2L;
+					} while (c != TMR2H);
+					rx_stamp_low |= (uint16_t)c << 8;
+					rx_stamp_high = timer2_high;
+					if (TF2H && c < 0x80) {
+						// timer2 has wrapped but its
+						// interrupt hasn't run yet
+						rx_stamp_high++;
+					}
+					rx_stamp_pos = rx_consumed + BUF_USED(rx);
+					rx_stamp_armed = false;
+					rx_stamp_valid = true;
+				}
+#endif // LATENCY_MEASURE
 			} else {
 				if (errors.serial_rx_overflow != 0xFFFF) {
 					errors.serial_rx_overflow++;
 				}
 			}
 #ifdef SERIAL_CTS
-			if (BUF_FREE(rx) < SERIAL_CTS_THRESHOLD_LOW) {
+			if (!SERIAL_CTS && BUF_FREE(rx) < SERIAL_CTS_THRESHOLD_LOW) {
 				SERIAL_CTS = true;
 			}
 #endif
@@ -187,6 +341,39 @@ serial_interrupt(void) __interrupt(INTERRUPT_UART0)
 }
 
 
+// check for the +++ escape sequence. This is a burst of exactly three
+// '+' with a guard time of silence before and after it. As before, a
+// pause between the '+' characters doesn't matter
+bool
+serial_escape_detect(void)
+{
+	bool ret = false;
+
+	if (!escape_dirty || SERIAL_RX_IDLE() < SERIAL_ESCAPE_GUARD) {
+		return false;
+	}
+
+	ES0_SAVE_DISABLE;
+	escape_dirty = false;
+	// with fewer than three '+' so far, keep waiting
+	if (escape_armed && escape_count == 3) {
+		escape_armed = false;
+		ret = true;
+	}
+	ES0_RESTORE;
+	return ret;
+}
+
+// restart the +++ guard time
+void
+serial_escape_reset(void)
+{
+	ES0_SAVE_DISABLE;
+	serial_rx_seen = true;
+	escape_armed = false;
+	ES0_RESTORE;
+}
+
 /// check if RTS allows us to send more data
 ///
 void
@@ -198,7 +385,7 @@ serial_check_rts(void)
 }
 
 void
-serial_init(register uint8_t speed)
+serial_init(register uint16_t speed)
 {
 	// disable UART interrupts
 	ES0 = 0;
@@ -206,13 +393,40 @@ serial_init(register uint8_t speed)
 	// reset buffer state, discard all data
 	rx_insert = 0;
 	rx_remove = 0;
+	rx_consumed = 0;
+	rx_marks = 0;
+	rx_frame_insert = 0;
+	rx_frame_remove = 0;
+#ifdef LATENCY_MEASURE
+	rx_stamp_armed = false;
+	rx_stamp_valid = false;
+	tx_written = 0;
+#endif
 	tx_insert = 0;
   tx_remove = 0;
 #ifdef CPU_SI1030
   encrypt_insert = 0;
   encrypt_remove = 0;
+  decrypt_queued = 0;
+  decrypt_queued_peak = 0;
 #endif
+
+	// split the arena. The decrypt queue is only needed if
+	// encryption is enabled, otherwise rx gets its space
+	rx_size = RX_BUFF_MAX;
+	tx_size = TX_BUFF_MAX;
+#ifdef INCLUDE_AES
+	if (param_get(PARAM_ENCRYPTION) != 0) {
+		encrypt_size = ENCRYPT_BUFF_MAX;
+	} else {
+		encrypt_size = 0;
+		rx_size += ENCRYPT_BUFF_MAX;
+	}
+	encrypt_buf = &serial_arena[ARENA_SIZE - encrypt_size];
+#endif
+	tx_buf = &serial_arena[RING_AREA() - tx_size];
 	tx_idle = true;
+	frame_gap_chars = param_get(PARAM_FRAME_GAP);
 
 	// configure timer 1 for bit clock generation
 	TR1 	= 0;				// timer off
@@ -253,6 +467,9 @@ _serial_write(register uint8_t c) __reentrant
 
 		// queue the character
 		BUF_INSERT(tx, c);
+#ifdef LATENCY_MEASURE
+		tx_written++;
+#endif
 
 		// if the transmitter is idle, restart it
 		if (tx_idle)
@@ -269,10 +486,9 @@ _serial_write(register uint8_t c) __reentrant
 bool
 decryptPackets(void)
 {
-  // Encrypted packets arn't bigger than 32 bytes
-  // Limited by packet.c packet_get_next()
+  // Encrypted packets can be as big as any air packet
   static __pdata uint8_t len_decrypted;
-  static __xdata uint8_t decrypt_buf[32];
+  static __xdata uint8_t decrypt_buf[MAX_PACKET_LENGTH];
   
   if(BUF_NOT_EMPTY(encrypt) && aes_get_encryption_level() > 0)
   {
@@ -283,11 +499,21 @@ decryptPackets(void)
       }
     }
     if (aes_decrypt(&encrypt_buf[encrypt_remove+1], encrypt_buf[encrypt_remove], decrypt_buf, &len_decrypted) != 0) {
-      panic("error while trying to decrypt data");
+      // it only had to pass a CRC check to get here, so a packet
+      // that isn't cipher text is dropped, not a reason to reboot
+      if (errors.decrypt_errors != 0xFFFF) {
+        errors.decrypt_errors++;
+      }
+#ifdef LATENCY_MEASURE
+      latency_rx_decrypted(false);
+#endif
+    } else {
+      // Now send decrypted output to serial buffer
+      serial_write_buf(decrypt_buf, len_decrypted);
+#ifdef LATENCY_MEASURE
+      latency_rx_decrypted(true);
+#endif
     }
-   
-    // Now send decrypted output to serial buffer
-    serial_write_buf(decrypt_buf, len_decrypted);
 
     // zero the packet as we read it.
     len_decrypted = encrypt_buf[encrypt_remove];
@@ -296,10 +522,11 @@ decryptPackets(void)
     // printf("eb %u:%u!%u - ea ",encrypt_remove, encrypt_insert, len_decrypted);
     __critical {
       encrypt_remove += len_decrypted + 1;
-      if (encrypt_remove >= sizeof(encrypt_buf)) {
+      if (encrypt_remove >= encrypt_size) {
         encrypt_remove = 0;
       }
     }
+    decrypt_queued--;
    // printf("%u\n",encrypt_remove);
     return true;
   }
@@ -309,17 +536,29 @@ decryptPackets(void)
 void
 serial_decrypt_buf(__xdata uint8_t * buf, __pdata uint8_t count)
 {
-  __pdata uint16_t space;
+  __pdata uint16_t need;
 
   if (aes_get_encryption_level() > 0) {
-    // write to the end of the ring buffer or front if we dont have space
-    if (count > sizeof(encrypt_buf) - (encrypt_insert + 1)) {
-      encrypt_insert = 0;
+    // a record is a length byte and the packet, and it must be
+    // followed by the zero length that marks where the parser
+    // wraps. Records never wrap, so if it won't fit at the end of
+    // the buffer it goes at the front. The insert point must never
+    // catch up with the remove point
+    need = count + 2;
+    if (encrypt_insert >= encrypt_remove) {
+      if (encrypt_size - encrypt_insert < need) {
+        if (encrypt_remove <= need) {
+          need = 0;
+        } else {
+          // the zero marker is already at encrypt_insert
+          encrypt_insert = 0;
+        }
+      }
+    } else if (encrypt_remove - encrypt_insert <= need) {
+      need = 0;
     }
 
-    // If we don't have enough space at all then exit
-    space = encrypt_buffer_write_space();
-    if (count > space) {
+    if (need == 0) {
             if (errors.serial_tx_overflow != 0xFFFF) {
                     errors.serial_tx_overflow++;
             }
@@ -336,12 +575,17 @@ serial_decrypt_buf(__xdata uint8_t * buf, __pdata uint8_t count)
     
     __critical {
       encrypt_insert += count + 1;
-      if (encrypt_insert >= sizeof(encrypt_buf)) {
-        encrypt_insert -= sizeof(encrypt_buf);
+      if (encrypt_insert >= encrypt_size) {
+        encrypt_insert -= encrypt_size;
       }
     }
     // Zero the next packet for the parser.
     encrypt_buf[encrypt_insert] = 0;
+
+    decrypt_queued++;
+    if (decrypt_queued > decrypt_queued_peak) {
+      decrypt_queued_peak = decrypt_queued;
+    }
   }
   else {
     serial_write_buf(buf, count);
@@ -349,22 +593,73 @@ serial_decrypt_buf(__xdata uint8_t * buf, __pdata uint8_t count)
 }
 #endif // INCLUDE_AES
 
+// double the rx or tx ring when it is more than three quarters full
+// and the other ring is empty, halving the other ring if the two no
+// longer fit, but not below its minimum size. A ring can only grow
+// while its contents don't wrap, as the new space must follow its
+// last byte.
+void
+serial_rebalance(void)
+{
+	__pdata uint16_t area, other;
+
+	ES0_SAVE_DISABLE;
+	area = RING_AREA();
+	if (BUF_FREE(rx) < rx_size/4 &&
+	    BUF_EMPTY(tx) &&
+	    rx_insert >= rx_remove) {
+		other = tx_size;
+		while (2*rx_size + other > area && other >= 2*TX_BUFF_MIN) {
+			other /= 2;
+		}
+		if (2*rx_size + other <= area) {
+			// rx grows up towards tx, which moves to the
+			// top of what is left
+			rx_size *= 2;
+			tx_size = other;
+			tx_buf = &serial_arena[area - other];
+			tx_insert = tx_remove = 0;
+		}
+	} else if (BUF_FREE(tx) < tx_size/4 &&
+		   BUF_EMPTY(rx) &&
+		   tx_insert >= tx_remove) {
+		other = rx_size;
+		while (2*tx_size + other > area && other >= 2*RX_BUFF_MIN) {
+			other /= 2;
+		}
+		if (2*tx_size + other <= area) {
+			// tx grows down towards rx. The tx bytes stay
+			// where they are, so their indices move up
+			tx_insert += tx_size;
+			tx_remove += tx_size;
+			tx_buf -= tx_size;
+			tx_size *= 2;
+			rx_size = other;
+			rx_insert = rx_remove = 0;
+		}
+	}
+	ES0_RESTORE;
+}
+
 // write as many bytes as will fit into the serial transmit buffer
 // if encryption turned on, decrypt the packet.
 void
 serial_write_buf(__xdata uint8_t * buf, __pdata uint8_t count)
 {
-	__pdata uint16_t space;
-	__pdata uint8_t n1;
+	__pdata uint16_t space, n1;
+	__xdata uint8_t *p;
 
 	if (count == 0) {
 		return;
 	}
-  
+
+	// borrow space from the rx ring if we are getting full
+	serial_rebalance();
+
 	// discard any bytes that don't fit. We can't afford to
 	// wait for the buffer to drain as we could miss a frequency
 	// hopping transition
-	space = serial_write_space();	
+	space = serial_write_space();
 	if (count > space) {
 		count = space;
 		if (errors.serial_tx_overflow != 0xFFFF) {
@@ -372,33 +667,50 @@ serial_write_buf(__xdata uint8_t * buf, __pdata uint8_t count)
 		}
 	}
 
-	// write to the end of the ring buffer
-	n1 = count;
-	if (n1 > sizeof(tx_buf) - tx_insert) {
-		n1 = sizeof(tx_buf) - tx_insert;
+	// write to the end of the ring buffer, and any leftover
+	// bytes to the start
+	p = serial_write_span(&n1);
+	if (n1 > count) {
+		n1 = count;
 	}
-	memcpy(&tx_buf[tx_insert], buf, n1);
-	buf += n1;
-	count -= n1;
-	__critical {
-		tx_insert += n1;
-		if (tx_insert >= sizeof(tx_buf)) {
-			tx_insert -= sizeof(tx_buf);
-		}
+	memcpy(p, buf, n1);
+	if (count > n1) {
+		memcpy(&tx_buf[0], buf + n1, count - n1);
 	}
+	serial_write_commit(count);
+}
 
-	// add any leftover bytes to the start of the ring buffer
-	if (count != 0) {
-		memcpy(&tx_buf[0], buf, count);
-		__critical {
-			tx_insert = count;
-		}		
+// return the contiguous free space at the insert end of the
+// transmit buffer
+__xdata uint8_t *
+serial_write_span(__pdata uint16_t * __data count)
+{
+	register uint16_t n;
+	ES0_SAVE_DISABLE;
+	n = BUF_FREE(tx);
+	ES0_RESTORE;
+	// the ISR only moves tx_remove, so tx_insert is stable here
+	if (n > tx_size - tx_insert) {
+		n = tx_size - tx_insert;
 	}
-	__critical {
-		if (tx_idle) {
-			serial_restart();
-		}
+	*count = n;
+	return &tx_buf[tx_insert];
+}
+
+// queue bytes written after serial_write_span() and make sure the
+// transmitter is running
+void
+serial_write_commit(__pdata uint16_t count)
+{
+	ES0_SAVE_DISABLE;
+	BUF_ADVANCE(tx, tx_insert, count);
+#ifdef LATENCY_MEASURE
+	tx_written += count;
+#endif
+	if (tx_idle) {
+		serial_restart();
 	}
+	ES0_RESTORE;
 }
 
 uint16_t
@@ -434,6 +746,7 @@ serial_read(void)
 
 	if (BUF_NOT_EMPTY(rx)) {
 		BUF_REMOVE(rx, c);
+		rx_consumed++;
 	} else {
 		c = '\0';
 	}
@@ -480,60 +793,300 @@ bool
 serial_read_buf(__xdata uint8_t * buf, __pdata uint8_t count)
 {
 	__pdata uint16_t n1;
+	__xdata uint8_t *p;
+
 	// the caller should have already checked this, 
 	// but lets be sure
 	if (count > serial_read_available()) {
 		return false;
 	}
-	// see how much we can copy from the tail of the buffer
-	n1 = count;
-	if (n1 > sizeof(rx_buf) - rx_remove) {
-		n1 = sizeof(rx_buf) - rx_remove;
-	}
-	memcpy(buf, &rx_buf[rx_remove], n1);
-	count -= n1;
-	buf += n1;
-	// update the remove marker with interrupts disabled
-	__critical {
-		rx_remove += n1;
-		if (rx_remove >= sizeof(rx_buf)) {
-			rx_remove -= sizeof(rx_buf);
-		}
+
+	// copy from the tail of the buffer, then any more from the start
+	p = serial_read_span(&n1);
+	if (n1 > count) {
+		n1 = count;
 	}
-	// any more bytes to do?
-	if (count > 0) {
-		memcpy(buf, &rx_buf[0], count);
-		__critical {
-			rx_remove = count;
-		}		
+	memcpy(buf, p, n1);
+	if (count > n1) {
+		memcpy(buf + n1, &rx_buf[0], count - n1);
 	}
+	serial_read_consume(count);
+	return true;
+}
 
+// return the contiguous run of received bytes at the remove end of
+// the receive buffer
+__xdata uint8_t *
+serial_read_span(__pdata uint16_t * __data count)
+{
+	register uint16_t n;
+	ES0_SAVE_DISABLE;
+	n = BUF_USED(rx);
+	ES0_RESTORE;
+	// the ISR only moves rx_insert, so rx_remove is stable here
+	if (n > rx_size - rx_remove) {
+		n = rx_size - rx_remove;
+	}
+	*count = n;
+	return &rx_buf[rx_remove];
+}
+
+// remove bytes from the receive buffer after serial_read_span()
+void
+serial_read_consume(__pdata uint16_t count)
+{
+	ES0_SAVE_DISABLE;
+	BUF_ADVANCE(rx, rx_remove, count);
+	rx_consumed += count;
 #ifdef SERIAL_CTS
-	__critical {
-		if (BUF_FREE(rx) > SERIAL_CTS_THRESHOLD_HIGH) {
-			SERIAL_CTS = false;
-		}
+	if (BUF_FREE(rx) > SERIAL_CTS_THRESHOLD_HIGH) {
+		SERIAL_CTS = false;
 	}
 #endif
-	return true;
+	ES0_RESTORE;
 }
 
 uint16_t
 serial_read_available(void)
 {
 	register uint16_t ret;
+
+	// borrow space from the tx ring if we are getting full
+	serial_rebalance();
+
 	ES0_SAVE_DISABLE;
 	ret = BUF_USED(rx);
 	ES0_RESTORE;
 	return ret;
 }
 
+// remove a receive time mark
+static void
+serial_rx_mark_remove(register uint8_t i)
+{
+	rx_marks--;
+	for (; i < rx_marks; i++) {
+		rx_mark_pos[i] = rx_mark_pos[i+1];
+		rx_mark_time[i] = rx_mark_time[i+1];
+	}
+}
+
+// forget the marks for data that has been read
+static void
+serial_rx_mark_retire(void)
+{
+	while (rx_marks != 0 && (int16_t)(rx_mark_pos[0] - rx_consumed) <= 0) {
+		serial_rx_mark_remove(0);
+	}
+}
+
+// note the arrival time of newly received bytes. When we run out of
+// marks two neighbours are merged, picking the pair closest in time.
+// The merged bytes take the later time, so ages are never overstated.
+// Nothing needs the marks unless MAX_DELAY is set
+void
+serial_rx_timestamp(void)
+{
+	register uint16_t pos, now, gap, best_gap;
+	register uint8_t i, best;
+
+	if (param_get(PARAM_MAX_DELAY) == 0) {
+		rx_marks = 0;
+		return;
+	}
+
+	ES0_SAVE_DISABLE;
+	pos = rx_consumed + BUF_USED(rx);
+	ES0_RESTORE;
+	now = timer2_msec();
+
+	serial_rx_mark_retire();
+
+	// hold old marks at RX_MARK_AGE_MAX, so that data which has
+	// waited longer than timer2_msec() takes to wrap doesn't look
+	// fresh again
+	for (i = 0; i < rx_marks; i++) {
+		if ((uint16_t)(now - rx_mark_time[i]) <= RX_MARK_AGE_MAX) {
+			break;
+		}
+		rx_mark_time[i] = now - RX_MARK_AGE_MAX;
+	}
+
+	if (rx_marks != 0) {
+		if (rx_mark_pos[rx_marks-1] == pos ||
+		    (uint16_t)(now - rx_mark_time[rx_marks-1]) < RX_MARK_SPACING) {
+			// nothing new, or too soon for another mark
+			return;
+		}
+	} else if (pos == rx_consumed) {
+		// nothing queued
+		return;
+	}
+
+	if (rx_marks == RX_MARKS) {
+		best = 0;
+		best_gap = 0xFFFF;
+		for (i = 0; i < RX_MARKS-1; i++) {
+			gap = rx_mark_time[i+1] - rx_mark_time[i];
+			if (gap < best_gap) {
+				best_gap = gap;
+				best = i;
+			}
+		}
+		serial_rx_mark_remove(best);
+	}
+	rx_mark_pos[rx_marks] = pos;
+	rx_mark_time[rx_marks] = now;
+	rx_marks++;
+}
+
+// return how long the oldest byte in the receive buffer has been
+// waiting, in msec. This is a lower bound, as it is based on the
+// first mark after the byte
+uint16_t
+serial_read_age(void)
+{
+	register uint16_t age;
+
+	serial_rx_mark_retire();
+	if (rx_marks == 0) {
+		return 0;
+	}
+	age = timer2_msec() - rx_mark_time[0];
+	if (age > RX_MARK_AGE_MAX) {
+		age = RX_MARK_AGE_MAX;
+	}
+	return age;
+}
+
+// return the number of bytes at the head of the receive buffer that
+// arrived together, up to the first time mark
+uint16_t
+serial_read_chunk(void)
+{
+	serial_rx_mark_retire();
+	if (rx_marks == 0) {
+		return serial_read_available();
+	}
+	return rx_mark_pos[0] - rx_consumed;
+}
+
+#ifdef LATENCY_MEASURE
+// timestamp the next byte received
+void
+serial_rx_stamp_arm(void)
+{
+	ES0_SAVE_DISABLE;
+	rx_stamp_valid = false;
+	rx_stamp_armed = true;
+	ES0_RESTORE;
+}
+
+// return true if the timestamped byte has been received
+bool
+serial_rx_stamp_taken(void)
+{
+	return rx_stamp_valid;
+}
+
+// return true if the timestamped byte has been read out of the
+// receive buffer
+bool
+serial_rx_stamp_consumed(void)
+{
+	register bool ret;
+	ES0_SAVE_DISABLE;
+	ret = rx_stamp_valid && (int16_t)(rx_consumed - rx_stamp_pos) >= 0;
+	ES0_RESTORE;
+	return ret;
+}
+
+// return the time the timestamped byte arrived, in the units of
+// timer2_tick32()
+uint32_t
+serial_rx_stamp_time(void)
+{
+	return (((uint32_t)rx_stamp_high)<<11) | (rx_stamp_low>>5);
+}
+
+// return the transmit position after the last byte written
+uint16_t
+serial_write_mark(void)
+{
+	return tx_written;
+}
+
+// return true once everything written before a serial_write_mark()
+// position has left the transmit buffer
+bool
+serial_write_drained(__pdata uint16_t mark)
+{
+	register uint16_t used;
+	ES0_SAVE_DISABLE;
+	used = BUF_USED(tx);
+	ES0_RESTORE;
+	return (int16_t)(tx_written - used - mark) >= 0;
+}
+#endif // LATENCY_MEASURE
+
+// set the gap in the serial input that ends a frame, in character
+// times. Zero turns frame detection off
+void
+serial_set_frame_gap(__pdata uint8_t chars)
+{
+	__pdata uint32_t counts = (uint32_t)chars * char_counts;
+
+	if (counts > FRAME_GAP_MAX) {
+		counts = FRAME_GAP_MAX;
+	}
+	ES0_SAVE_DISABLE;
+	frame_gap_chars = chars;
+	frame_gap = counts;
+	rx_frame_insert = rx_frame_remove = 0;
+	ES0_RESTORE;
+}
+
+// return the length of the frame at the head of the receive buffer,
+// or zero if we are still receiving it
+uint16_t
+serial_read_frame(void)
+{
+	register uint16_t n, now;
+	register uint8_t high;
+
+	ES0_SAVE_DISABLE;
+	// forget the frames that have been read
+	while (rx_frame_remove != rx_frame_insert &&
+	       (int16_t)(rx_frame_start[rx_frame_remove] - rx_consumed) <= 0) {
+		rx_frame_remove = (rx_frame_remove + 1) & RX_FRAMES_MASK;
+	}
+	if (rx_frame_remove != rx_frame_insert) {
+		// it ends where the next one starts
+		n = rx_frame_start[rx_frame_remove] - rx_consumed;
+	} else {
+		// it is the last frame, which has ended if the line
+		// has been quiet for long enough
+		do {
+			high = TMR2H;
+			now = TMR2L;
+		} while (high != TMR2H);
+		now |= (uint16_t)high << 8;
+		if (SERIAL_RX_IDLE() >= 3 || (uint16_t)(now - rx_last_byte) >= frame_gap) {
+			n = BUF_USED(rx);
+		} else {
+			n = 0;
+		}
+	}
+	ES0_RESTORE;
+	return n;
+}
+
 // return available space in rx buffer as a percentage
 uint8_t
 serial_read_space(void)
 {
-	uint16_t space = sizeof(rx_buf) - serial_read_available();
-	space = (100 * (space/8)) / (sizeof(rx_buf)/8);
+	uint16_t space = rx_size - serial_read_available();
+	space = (100 * (space/8)) / (rx_size/8);
 	return space;
 }
 
@@ -552,8 +1105,12 @@ putchar(char c) __reentrant
 /// serial rate scheme that APM uses. If an unsupported
 /// rate is chosen then 57600 is used
 ///
+/// The rates from 57600 up clock timer1 from SYSCLK, giving
+/// SYSCLK / (2 * (256 - th1)). At 24.5MHz 460800 is 1.5% slow and
+/// 921600 is 2.2% fast, which is as close as the clock tree allows.
+///
 static const __code struct {
-	uint8_t rate;
+	uint16_t rate;
 	uint8_t th1;
 	uint8_t ckcon;
 } serial_rates[] = {
@@ -566,13 +1123,15 @@ static const __code struct {
 	{57,  0x2b, 0x08}, // 57600 - default
 	{115, 0x96, 0x08}, // 115200
 	{230, 0xcb, 0x08}, // 230400
+	{460, 0xe5, 0x08}, // 460800
+	{921, 0xf3, 0x08}, // 921600
 };
 
 //
 // check if a serial speed is valid
 //
 bool 
-serial_device_valid_speed(register uint8_t speed)
+serial_device_valid_speed(register uint16_t speed)
 {
 	uint8_t i;
 	uint8_t num_rates = ARRAY_LENGTH(serial_rates);
@@ -586,7 +1145,7 @@ serial_device_valid_speed(register uint8_t speed)
 }
 
 static 
-void serial_device_set_speed(register uint8_t speed)
+void serial_device_set_speed(register uint16_t speed)
 {
 	uint8_t i;
 	uint8_t num_rates = ARRAY_LENGTH(serial_rates);
@@ -604,6 +1163,10 @@ void serial_device_set_speed(register uint8_t speed)
 	TH1 = serial_rates[i].th1;
 	CKCON = (CKCON & ~0x0b) | serial_rates[i].ckcon;
 
+	// timer2 counts in one 10 bit character, for frame gaps
+	char_counts = ((SYSCLK / 12) / 100) / serial_rates[i].rate;
+	serial_set_frame_gap(frame_gap_chars);
+
 	// tell the packet layer how fast the serial link is. This is
 	// needed for packet framing timeouts
 	packet_set_serial_speed(speed*125UL);	
@@ -611,39 +1174,27 @@ void serial_device_set_speed(register uint8_t speed)
 
 
 #ifdef INCLUDE_AES
-/// Indicate if encrypt buffer is starting to get too full
+/// Return the number of packets waiting to be decrypted
 //
-bool
-encrypt_buffer_getting_full()
-{
-	if (BUF_FREE(encrypt) < encrypt_buff_start) {
-           return true;
-        }
-
- return false;
-}
-
-
-/// Indicate if encrypt before is getting back to a more comfortable lower state
-//
-bool
-encrypt_buffer_getting_empty()
+uint16_t
+serial_decrypt_depth(void)
 {
-	if (BUF_FREE(encrypt) > encrypt_buff_end) {
-           return true;
-        }
- return false;
+	if (aes_get_encryption_level() == 0) {
+		return 0;
+	}
+	return decrypt_queued;
 }
 
-
-/// Return amount of space left in buffer
+/// Return the most packets that have waited to be decrypted since
+/// the last call
 //
 uint16_t
-encrypt_buffer_write_space()
+serial_decrypt_peak(void)
 {
 	register uint16_t ret;
-        ret = BUF_FREE(encrypt);
-        return ret;
+	ret = decrypt_queued_peak;
+	decrypt_queued_peak = decrypt_queued;
+	return ret;
 }
 
 
@@ -45,13 +45,13 @@
 ///				to serial_device_set_speed at the appropriate
 ///				point during initialisation.
 ///
-extern void	serial_init(register uint8_t speed);
+extern void	serial_init(register uint16_t speed);
 
 /// check if a serial speed is valid
 ///
 /// @param	speed		The serial speed to configure
 ///
-extern bool serial_device_valid_speed(register uint8_t speed);
+extern bool serial_device_valid_speed(register uint16_t speed);
 
 /// Write a byte to the serial port.
 ///
@@ -68,26 +68,45 @@ extern bool	serial_write(register uint8_t c);
 ///
 extern void	serial_write_buf(__xdata uint8_t * buf, __pdata uint8_t count);
 
+/// Get the contiguous free space at the end of the write FIFO, so
+/// a producer can copy straight into it. Follow with
+/// serial_write_commit().
+///
+/// @param	count		Set to the number of bytes that can be
+///				written at the returned pointer.
+/// @return			Where to write the next byte.
+///
+extern __xdata uint8_t * serial_write_span(__pdata uint16_t * __data count);
+
+/// Queue bytes copied into the write FIFO after serial_write_span().
+/// The bytes may run past the span and wrap to the start of the FIFO,
+/// as long as count is no more than serial_write_space().
+///
+/// @param	count		The number of bytes written.
+///
+extern void	serial_write_commit(__pdata uint16_t count);
+
 #ifdef INCLUDE_AES
 extern void serial_decrypt_buf(__xdata uint8_t * buf, __pdata uint8_t count);
 
-/// Encryption ring buffer checks. Is it getting too full?
-//
-extern bool encrypt_buffer_getting_full();
-
-/// Encryption ring buffer checks. Is it getting empty now?
+/// Number of packets waiting to be decrypted
 //
-extern bool encrypt_buffer_getting_empty();
+extern uint16_t serial_decrypt_depth(void);
 
-/// Get space left in encrypt buffer
+/// Most packets waiting to be decrypted since the last call
 //
-extern uint16_t encrypt_buffer_write_space();
+extern uint16_t serial_decrypt_peak(void);
 #endif // INCLUDE_AES
 
 /// Decrypt any packets in the buffer and push to the serial layer
 ///
 extern bool decryptPackets(void);
 
+/// Lend buffer space between the read and write FIFOs. Called as
+/// part of serial_write_buf() and serial_read_available().
+///
+extern void	serial_rebalance(void);
+
 /// Check for space in the write FIFO
 ///
 /// @return			The number of bytes that can be written.
@@ -133,6 +152,24 @@ extern uint8_t	serial_peekx(uint16_t offset);
 ///
 extern bool	serial_read_buf(__xdata uint8_t * buf, __pdata uint8_t count);
 
+/// Get the contiguous run of bytes at the head of the read FIFO, so
+/// a consumer can copy straight out of it. Follow with
+/// serial_read_consume().
+///
+/// @param	count		Set to the number of bytes that can be
+///				read at the returned pointer.
+/// @return			The next byte in the receive FIFO.
+///
+extern __xdata uint8_t * serial_read_span(__pdata uint16_t * __data count);
+
+/// Remove bytes from the read FIFO after serial_read_span(). The
+/// bytes may run past the span and wrap to the start of the FIFO, as
+/// long as count is no more than serial_read_available().
+///
+/// @param	count		The number of bytes consumed.
+///
+extern void	serial_read_consume(__pdata uint16_t count);
+
 /// Check for bytes in the read FIFO
 ///
 /// @return			The number of bytes available to be read
@@ -140,6 +177,104 @@ extern bool	serial_read_buf(__xdata uint8_t * buf, __pdata uint8_t count);
 ///
 extern uint16_t	serial_read_available(void);
 
+/// Note the arrival time of bytes received since the last call. Call
+/// this often from the main loop. It does nothing when MAX_DELAY is 0.
+///
+extern void	serial_rx_timestamp(void);
+
+/// Return how long the oldest byte in the receive buffer has been
+/// waiting, rounded down to the last serial_rx_timestamp() call.
+///
+/// @return			Age in units of about 1 msec, saturating at
+///				32768, or zero if the buffer is empty.
+///
+extern uint16_t	serial_read_age(void);
+
+/// Return the number of bytes at the head of the receive buffer that
+/// arrived together with the oldest byte.
+///
+/// @return			The byte count.
+///
+extern uint16_t	serial_read_chunk(void);
+
+/// Set the gap in the serial input that ends a frame.
+///
+/// @param chars		Gap in character times, zero to turn frame
+///				detection off.
+///
+extern void	serial_set_frame_gap(__pdata uint8_t chars);
+
+/// Return the length of the frame at the head of the receive buffer,
+/// when frame detection is on.
+///
+/// @return			The frame length, or zero if the frame is
+///				still being received.
+///
+extern uint16_t	serial_read_frame(void);
+
+/// Timestamp the next byte received, for latency measurement. The
+/// serial_rx_stamp_* and serial_write_mark/drained calls are only
+/// built when LATENCY_MEASURE is defined (see latency.h).
+///
+extern void	serial_rx_stamp_arm(void);
+
+/// Check if the byte asked for by serial_rx_stamp_arm() has arrived.
+///
+/// @return			True if the timestamp is valid.
+///
+extern bool	serial_rx_stamp_taken(void);
+
+/// Check if the timestamped byte has been read from the receive buffer.
+///
+/// @return			True if it has been read.
+///
+extern bool	serial_rx_stamp_consumed(void);
+
+/// Return the arrival time of the timestamped byte.
+///
+/// @return			Time in timer2_tick32() units.
+///
+extern uint32_t	serial_rx_stamp_time(void);
+
+/// Return the position in the transmit stream after the last byte
+/// written, for use with serial_write_drained().
+///
+/// @return			The position.
+///
+extern uint16_t	serial_write_mark(void);
+
+/// Check if everything written before a position has been sent.
+///
+/// @param mark			A position from serial_write_mark().
+/// @return			True if those bytes have left the buffer.
+///
+extern bool	serial_write_drained(__pdata uint16_t mark);
+
+/// guard time of silence around the +++ escape sequence, in 100Hz ticks
+#define SERIAL_ESCAPE_GUARD	100
+
+/// 100Hz ticks since the last byte was received in data mode,
+/// saturating at 255. Only the timer3 interrupt writes it, as the
+/// UART interrupt can preempt it. The UART sets serial_rx_seen
+/// instead, which timer3 turns into a restart of the count, so use
+/// SERIAL_RX_IDLE() to read it.
+extern __data volatile uint8_t serial_rx_idle;
+extern volatile __bit serial_rx_seen;
+#define SERIAL_RX_IDLE()	(serial_rx_seen ? 0 : serial_rx_idle)
+
+/// Check for the +++ escape sequence. Call this from the main loop
+/// when at_mode_active is false.
+///
+/// @return			True if +++ was received with a guard time
+///				of silence before and after it.
+///
+extern bool	serial_escape_detect(void);
+
+/// Restart the guard time before a +++ escape sequence, for example
+/// when leaving AT command mode.
+///
+extern void	serial_escape_reset(void);
+
 /// check if RTS allows us to send more data
 ///
 extern void serial_check_rts(void);
@@ -39,22 +39,26 @@
 #include "timer.h"
 #include "packet.h"
 #include "golay.h"
+#include "rs.h"
 #include "freq_hopping.h"
 #include "crc.h"
 #include "serial.h"
+#include "latency.h"
 
 #ifdef INCLUDE_AES
 #include "AES/aes.h"
 #endif // INCLUDE_AES
 
 #define USE_TICK_YIELD 1
+#define USE_SHORT_PREAMBLE 1
+#define USE_IDLE_SLEEP 1
 
 /// the state of the tdm system
 enum tdm_state { TDM_TRANSMIT=0, TDM_SILENCE1=1, TDM_RECEIVE=2, TDM_SILENCE2=3 };
 __pdata static enum tdm_state tdm_state;
 
-/// a packet buffer for the TDM code
-__xdata uint8_t	pbuf[MAX_PACKET_LENGTH];
+/// a packet buffer for the TDM code, used through pbuf
+__xdata uint8_t	pbuf_space[PACKET_HEADROOM + MAX_PACKET_LENGTH];
 
 /// how many 16usec ticks are remaining in the current state
 __pdata static uint16_t tdm_state_remaining;
@@ -94,6 +98,39 @@ __pdata static uint16_t packet_latency;
 /// the time in 16usec ticks for sending one byte
 __pdata static uint16_t ticks_per_byte;
 
+#if USE_SHORT_PREAMBLE
+/// packet_latency when sending the long acquisition preamble
+__pdata static uint16_t packet_latency_long;
+
+/// set when we are sending the short preamble
+static __bit short_preamble;
+#endif
+
+#if USE_IDLE_SLEEP
+/// don't bother going to sleep for less than this many 16usec ticks
+#define IDLE_MIN_TICKS 8
+
+/// 16usec ticks spent in IDLE since the last link update
+__pdata static uint16_t idle_ticks;
+
+/// percentage of time spent in IDLE over the last link update
+__pdata static uint8_t idle_percent;
+#endif
+
+#ifdef INCLUDE_AES
+/// 16usec ticks a decrypt is expected to take. This follows the
+/// slowest recent decrypt, decaying slowly, and is capped at
+/// DECRYPT_TICKS_MAX() so one slow measurement can't lock us out
+__pdata static uint16_t decrypt_ticks;
+
+/// largest decrypt estimate we will believe
+#define DECRYPT_TICKS_MAX() (tx_window_width / 4)
+
+/// with this many packets queued we decrypt even when we have
+/// serial data waiting to go out
+#define DECRYPT_URGENT 4
+#endif
+
 /// number of 16usec ticks to wait for a preamble to turn into a packet
 /// This is set when we get a preamble interrupt, and causes us to delay
 /// sending for a maximum packet latency. This is used to make it more likely
@@ -167,8 +204,17 @@ tdm_show_rssi(void)
 	       (unsigned)statistics.average_noise,
 	       (unsigned)remote_statistics.average_noise,
 	       (unsigned)statistics.receive_count);
+	printf(" sojourn=%u sdrop=%u",
+	       (unsigned)packet_sojourn,
+	       (unsigned)errors.serial_rx_dropped);
+#ifdef INCLUDE_ERASURE
+	printf(" rebuilt=%u", (unsigned)errors.rebuilt_packets);
+#endif
+#ifdef INCLUDE_COMBINE
+	printf(" combined=%u", (unsigned)errors.combined_packets);
+#endif
 #ifdef INCLUDE_AES
-	printf(" txe=%u rxe=%u stx=%u srx=%u ecc=%u/%u crce=%u temp=%d dco=%u\n",
+	printf(" txe=%u rxe=%u stx=%u srx=%u ecc=%u/%u crce=%u dce=%u dq=%u/%u temp=%d dco=%u\n",
 #else
   printf(" txe=%u rxe=%u stx=%u srx=%u ecc=%u/%u temp=%d dco=%u\n",
 #endif
@@ -180,6 +226,9 @@ tdm_show_rssi(void)
 	       (unsigned)errors.corrected_packets,
 #ifdef INCLUDE_AES
 	       (unsigned)errors.crc_errors,
+	       (unsigned)errors.decrypt_errors,
+	       (unsigned)serial_decrypt_depth(),
+	       (unsigned)serial_decrypt_peak(),
 #endif
 	       (int)radio_temperature(),
 	       (unsigned)duty_cycle_offset);
@@ -302,6 +351,13 @@ tdm_state_update(__pdata uint16_t tdelta)
       tdm_state_remaining = silence_period;
     }
     
+#ifdef RFD900_DIVERSITY
+    if (tdm_state == TDM_TRANSMIT) {
+      // choose the antenna for this TDM round
+      radio_diversity_window();
+    }
+#endif // RFD900_DIVERSITY
+
     // change frequency at the start and end of our transmit window
     // this maximises the chance we will be on the right frequency
     // to match the other radio
@@ -375,6 +431,33 @@ static void temperature_update(void)
 }
 
 
+#if USE_SHORT_PREAMBLE
+/// switch between the long preamble used for acquisition and the
+/// short preamble used while both radios are locked. This only
+/// changes our flight time estimates, not the TDM round timings, so
+/// the two ends can switch independently
+///
+static void
+set_short_preamble(bool use_short)
+{
+  if (use_short == short_preamble) {
+    return;
+  }
+  short_preamble = use_short;
+  if (use_short) {
+    radio_set_preamble_length(PREAMBLE_LENGTH_SHORT);
+    packet_latency = packet_latency_long -
+      ((PREAMBLE_LENGTH_LONG-PREAMBLE_LENGTH_SHORT)/2) * ticks_per_byte;
+  } else {
+    radio_set_preamble_length(PREAMBLE_LENGTH_LONG);
+    packet_latency = packet_latency_long;
+  }
+  if (at_testmode & AT_TEST_TDM) {
+    printf("TDM: preamble %u\n", (unsigned)settings.preamble_length);
+  }
+}
+#endif // USE_SHORT_PREAMBLE
+
 /// blink the radio LED if we have not received any packets
 ///
 static void
@@ -440,9 +523,22 @@ link_update(void)
   if (unlock_count > 5) {
     memset(&remote_statistics, 0, sizeof(remote_statistics));
   }
+
+#if USE_SHORT_PREAMBLE
+  // we only shorten our preamble while we are hearing the other
+  // radio and its statistics show it is hearing us. Otherwise go back
+  // to the long preamble so it can re-acquire us
+  set_short_preamble(unlock_count < 2 && remote_statistics.receive_count != 0);
+#endif
   
   test_display = at_testmode;
   send_statistics = 1;
+
+#if USE_IDLE_SLEEP
+  // link_update() is called every 32768 ticks
+  idle_percent = ((uint32_t)idle_ticks * 100) >> 15;
+  idle_ticks = 0;
+#endif
   
   temperature_count++;
   if (temperature_count == 4) {
@@ -483,7 +579,7 @@ handle_at_command(__pdata uint8_t len)
   // run the AT command, capturing any output to the packet
   // buffer
   // this reply buffer will be sent at the next opportunity
-  printf_start_capture(pbuf, sizeof(pbuf));
+  printf_start_capture(pbuf, MAX_PACKET_LENGTH);
   at_command();
   len = printf_end_capture();
   if (len > 0) {
@@ -492,6 +588,175 @@ handle_at_command(__pdata uint8_t len)
  return false;
 }
 
+#if USE_IDLE_SLEEP
+/// put the CPU in IDLE while we have nothing to do for the given
+/// number of 16usec ticks. The radio, serial and timer interrupts all
+/// wake us early, and the timer0 wakeup means we never sleep past a
+/// TDM state change, so no timing is lost
+///
+static void
+tdm_idle(__pdata uint16_t ticks)
+{
+  __pdata uint16_t t1;
+
+  if (ticks < IDLE_MIN_TICKS) {
+    return;
+  }
+
+  // don't sleep while a packet is coming in, so we process it as
+  // soon as it completes and our window sync stays accurate
+  if (radio_receive_in_progress()) {
+    return;
+  }
+
+#ifdef INCLUDE_AES
+  // there is decrypting to do instead
+  if (serial_decrypt_depth() != 0) {
+    return;
+  }
+#endif
+
+  t1 = timer2_tick();
+  timer_wake_set(ticks);
+  PCON |= 0x01;
+  PCON = PCON;    // 3 cycle dummy instruction after IDLE
+  idle_ticks += timer2_tick() - t1;
+}
+#else
+#define tdm_idle(ticks)
+#endif // USE_IDLE_SLEEP
+
+#ifdef INCLUDE_AES
+/// decrypt one queued packet, as long as it can't hold up a transmit.
+/// The AES engine idles the CPU while its DMA runs, so a decrypt is
+/// a fixed block of time. It is only started if the current TDM state
+/// has that long left, plus time for a packet if we could be sending.
+/// While we have serial data to send our window is kept for it,
+/// unless the queue is building up
+///
+static void
+tdm_decrypt(void)
+{
+  __pdata uint16_t need, t1;
+  __pdata uint16_t depth;
+
+  depth = serial_decrypt_depth();
+  if (depth == 0) {
+    return;
+  }
+
+  need = decrypt_ticks;
+  if (tdm_state == TDM_TRANSMIT ||
+      (bonus_transmit && tdm_state == TDM_RECEIVE)) {
+    if (depth < DECRYPT_URGENT && serial_read_available() != 0) {
+      return;
+    }
+    need += packet_latency;
+  } else if (depth >= DECRYPT_URGENT) {
+    // we can't be sending, and the queue is building up, so
+    // don't let the estimate hold the decrypt back
+    need = 0;
+  }
+  if (tdm_state_remaining <= need) {
+    // let the estimate decay while we wait, so a stale peak
+    // can't keep us out of every window
+    if (decrypt_ticks != 0) {
+      decrypt_ticks--;
+    }
+    return;
+  }
+
+  // one packet per call, so this times a single decrypt
+  t1 = timer2_tick();
+  decryptPackets();
+  t1 = timer2_tick() - t1;
+  if (t1 > decrypt_ticks) {
+    decrypt_ticks = t1;
+  } else {
+    decrypt_ticks -= (decrypt_ticks - t1) / 16;
+  }
+  if (decrypt_ticks > DECRYPT_TICKS_MAX()) {
+    decrypt_ticks = DECRYPT_TICKS_MAX();
+  }
+}
+
+/// check a received packet against the CRC in its trailer, as we
+/// can't decrypt a packet that is corrupt
+///
+/// @param len			number of bytes in pbuf
+/// @return			true if the packet can be used
+static bool
+tdm_crc_ok(__pdata uint8_t len)
+{
+  if (crc16(len, pbuf) != trailer.crc) {
+    if (errors.crc_errors != 0xFFFF) {
+      errors.crc_errors++;
+    }
+    return false;
+  }
+  return true;
+}
+#else
+// the radio has already checked the packet
+#define tdm_crc_ok(len) true
+#endif // INCLUDE_AES
+
+/// send received user data out the serial port
+///
+/// @param len			number of bytes in pbuf
+static void
+tdm_deliver(__pdata uint8_t len)
+{
+  LED_ACTIVITY = LED_ON;
+#ifdef INCLUDE_AES
+  serial_decrypt_buf(pbuf, len);
+#else
+  serial_write_buf(pbuf, len);
+#endif
+  LED_ACTIVITY = LED_OFF;
+#ifdef LATENCY_MEASURE
+  latency_rx_packet(len, pbuf);
+#endif
+}
+
+#ifdef INCLUDE_ERASURE
+/// handle a received data or parity packet when parity is on. A packet
+/// only goes into its parity group once it has passed the CRC and
+/// duplicate checks, so a bad or repeated packet can't spoil a rebuild
+///
+/// @param len			number of bytes in pbuf, with the tag
+static void
+tdm_erasure_receive(__pdata uint8_t len)
+{
+  if (packet_erasure_is_parity(len, pbuf)) {
+    // the parity packet's CRC covers all of it
+    if (!tdm_crc_ok(len)) {
+      return;
+    }
+    len = packet_erasure_receive(len, pbuf);
+    if (len != 0) {
+      // a rebuilt packet is made from packets that passed their
+      // checks. Note it, so a later resend of it is a duplicate
+      packet_is_duplicate(len, pbuf, false);
+      if (!at_mode_active) {
+        tdm_deliver(len);
+      }
+    }
+    return;
+  }
+
+  // a data packet's CRC and the duplicate check don't cover the tag
+  if (!tdm_crc_ok(len-1) ||
+      packet_is_duplicate(len-1, pbuf, trailer.resend)) {
+    return;
+  }
+  len = packet_erasure_receive(len, pbuf);
+  if (!at_mode_active) {
+    tdm_deliver(len);
+  }
+}
+#endif // INCLUDE_ERASURE
+
 // a stack carary to detect a stack overflow
 __at(0xFF) uint8_t __idata _canary;
 
@@ -510,9 +775,12 @@ tdm_serial_loop(void)
   __pdata uint8_t	len;
   __pdata uint16_t tnow, tdelta;
   __pdata uint8_t max_xmit;
-#ifdef INCLUDE_AES
-  __pdata uint16_t crc;
-#endif // INCLUDE_AES  
+  __pdata uint16_t tx_crc;
+  bool tx_crc_known;
+  bool tx_parity;
+#ifdef LATENCY_MEASURE
+  bool send_probe = false;
+#endif
   __pdata uint16_t last_t = timer2_tick();
   __pdata uint16_t last_link_update = last_t;
   
@@ -530,6 +798,12 @@ tdm_serial_loop(void)
     
     // give the AT command processor a chance to handle a command
     at_command();
+
+    // note when new serial data arrived, for the latency bound
+    serial_rx_timestamp();
+#ifdef LATENCY_MEASURE
+    latency_update();
+#endif
     
     // display test data if needed
     if (test_display) {
@@ -578,6 +852,11 @@ tdm_serial_loop(void)
         if (len == sizeof(struct statistics)) {
           memcpy(&remote_statistics, pbuf, len);
         }
+#ifdef LATENCY_MEASURE
+        else if (len == sizeof(struct latency_probe)) {
+          latency_rx_probe(pbuf);
+        }
+#endif
         
         // don't count control packets in the stats
         statistics.receive_count--;
@@ -587,6 +866,15 @@ tdm_serial_loop(void)
         sync_tx_windows(len);
         last_t = tnow;
         
+#ifdef INCLUDE_ERASURE
+        if (trailer.command == 0 && len != 0 &&
+            param_get(PARAM_PARITY_GROUP) != 0) {
+          // strip the parity group tag, or rebuild a lost packet
+          // from a parity packet
+          tdm_erasure_receive(len);
+          continue;
+        }
+#endif // INCLUDE_ERASURE
 
 	// Send data to console (serial buffers) if following conditions met
 	// If is a command and data is destined to THIS modem
@@ -602,26 +890,10 @@ tdm_serial_loop(void)
             )) 
         {
              // its user data - send it out
-             // the serial port
-#ifdef INCLUDE_AES
-             crc = crc16(len, pbuf);
-             // Only of CRC's agree do we process the pbuf
-             // (We can't decrypt a packet that is corrupt)
-             if (crc == trailer.crc) {
-                LED_ACTIVITY = LED_ON;
-                serial_decrypt_buf(pbuf, len);
-                LED_ACTIVITY = LED_OFF;
-             } else {
-		if (errors.crc_errors != 0xFFFF) {
-		   errors.crc_errors++; 
-		}
+             // the serial port, if its CRC agrees
+             if (tdm_crc_ok(len)) {
+                tdm_deliver(len);
              }
-#else // INCLUDE_AES
-             LED_ACTIVITY = LED_ON;
-             serial_write_buf(pbuf, len);
-             LED_ACTIVITY = LED_OFF;
-#endif // INCLUDE_AES
-          
         }
       }
       continue;
@@ -640,6 +912,12 @@ tdm_serial_loop(void)
       link_update();
       last_link_update = tnow;
     }
+
+#ifdef INCLUDE_AES
+    // decrypt received packets as they arrive, in time we
+    // wouldn't be sending
+    tdm_decrypt();
+#endif
     
 
     if (lbt_rssi != 0) {
@@ -665,21 +943,25 @@ tdm_serial_loop(void)
     if (tdm_state != TDM_TRANSMIT &&
           !(bonus_transmit && tdm_state == TDM_RECEIVE)) {
       // we cannot transmit now
+      tdm_idle(tdm_state_remaining);
       continue;
     }
 #else
     if (tdm_state != TDM_TRANSMIT) {
+      tdm_idle(tdm_state_remaining);
       continue;
     }		
 #endif
     
     if (transmit_yield != 0) {
       // we've give up our window
+      tdm_idle(tdm_state_remaining);
       continue;
     }
     
     if (transmit_wait != 0) {
       // we're waiting for a preamble to turn into a packet
+      tdm_idle(transmit_wait);
       continue;
     }
     
@@ -699,6 +981,7 @@ tdm_serial_loop(void)
     
     if (duty_cycle_wait) {
       // we're waiting for our duty cycle to drop
+      tdm_idle(tdm_state_remaining);
       continue;
     }
     
@@ -717,14 +1000,9 @@ tdm_serial_loop(void)
     max_xmit -= sizeof(trailer)+1;
     
 #ifdef INCLUDE_AES
-    if (aes_get_encryption_level() > 0) {
-      if (max_xmit < 16) {
-        // With AES, the cipher is up to 16 bytes larger than the text
-        // we are encrypting. So we make sure we have sufficient space
-        // i.e. min size of any cipher text is 16 bytes
-        continue;
-      }
-      max_xmit -= 16;
+    if (aes_get_encryption_level() > 0 && aes_plaintext_room(max_xmit) == 0) {
+      // no room for the smallest cipher text
+      continue;
     }
 #endif // INCLUDE_AES
     
@@ -737,6 +1015,9 @@ tdm_serial_loop(void)
     pins_user_check();
 #endif
     
+    tx_crc_known = false;
+    tx_parity = false;
+
     // ask the packet system for the next packet to send
     if (send_at_command && 
             max_xmit >= strlen(remote_at_cmd)) {
@@ -745,18 +1026,81 @@ tdm_serial_loop(void)
       memcpy(pbuf, remote_at_cmd, len);
       trailer.command = 1;
       send_at_command = false;
+#ifdef LATENCY_MEASURE
+    } else if (tdm_state == TDM_TRANSMIT &&
+               latency_probe_ready() &&
+               max_xmit >= sizeof(struct latency_probe)) {
+      // follow a sampled packet with its latency probe
+      len = latency_probe_build(pbuf);
+      trailer.command = 0;
+      send_probe = true;
+#endif
+#ifdef INCLUDE_ERASURE
+    } else if (param_get(PARAM_PARITY_GROUP) != 0 &&
+               (len = packet_erasure_parity(max_xmit, pbuf, false)) != 0) {
+      // a full parity group is followed by its parity packet
+      trailer.command = 0;
+      tx_parity = true;
+#ifdef INCLUDE_AES
+      trailer.crc = crc16(len, pbuf);
+#endif
+#endif
     } else {
+#ifdef INCLUDE_ERASURE
+      // leave room for the tag, and for the parity packet's
+      // extra bytes when this packet is the longest of its group
+      if (param_get(PARAM_PARITY_GROUP) != 0) {
+        max_xmit = max_xmit > PACKET_ERASURE_ROOM ? max_xmit - PACKET_ERASURE_ROOM : 0;
+      }
+#endif
       // get a packet from the serial port
+#ifdef LATENCY_MEASURE
+      latency_tx_prepare();
       len = packet_get_next(max_xmit, pbuf);
+      latency_tx_packet(len, pbuf);
+#else
+      len = packet_get_next(max_xmit, pbuf);
+#endif
+
+      if (len == 0 &&
+          feature_opportunistic_resend != 0 &&
+          tdm_state == TDM_TRANSMIT &&
+          ((duty_cycle - duty_cycle_offset) == 100 ||
+           average_duty_cycle < (duty_cycle - duty_cycle_offset)/2)) {
+        // nothing new to send, so use our window to send the
+        // last packet again rather than yield it. Under a duty
+        // cycle limit this only uses half of the allowance
+        len = packet_opportunistic_resend(max_xmit, pbuf);
+      }
 
       if (len > 0) {
          trailer.command = packet_is_injected();
       } else {
          trailer.command = 0;
       }
+      // the packet system took the CRC as it copied the packet out
+      tx_crc = len != 0 ? packet_crc() : 0;
+      tx_crc_known = true;
 #ifdef INCLUDE_AES
-      trailer.crc = crc16(len, pbuf);
+      trailer.crc = tx_crc;
 #endif
+#ifdef INCLUDE_ERASURE
+      if (param_get(PARAM_PARITY_GROUP) != 0) {
+        if (len != 0 && trailer.command == 0) {
+          len = packet_erasure_add(len, pbuf);
+          tx_crc = crc16_copy(1, &pbuf[len-1], &pbuf[len-1], tx_crc);
+        } else if (len == 0 && serial_read_available() == 0) {
+          // the serial data has run out, so protect the last
+          // group now rather than when the next burst fills it
+          len = packet_erasure_parity(max_xmit, pbuf, true);
+          tx_crc_known = false;
+          tx_parity = true;
+#ifdef INCLUDE_AES
+          trailer.crc = crc16(len, pbuf);
+#endif
+        }
+      }
+#endif // INCLUDE_ERASURE
     }
     
     if (len > max_data_packet_length) {
@@ -766,6 +1110,14 @@ tdm_serial_loop(void)
     trailer.bonus = (tdm_state == TDM_RECEIVE);
     trailer.resend = packet_is_resend();
     
+#ifdef LATENCY_MEASURE
+    if (send_probe) {
+      // a probe is a control packet, like statistics
+      send_probe = false;
+      trailer.window = 0;
+      trailer.resend = 0;
+    } else
+#endif
     if (tdm_state == TDM_TRANSMIT &&
             len == 0 &&
             send_statistics &&
@@ -774,6 +1126,7 @@ tdm_serial_loop(void)
       send_statistics = 0;
       memcpy(pbuf, &statistics, sizeof(statistics));
       len = sizeof(statistics);
+      tx_crc_known = false;
       
       // mark a stats packet with a zero window
       trailer.window = 0;
@@ -783,22 +1136,19 @@ tdm_serial_loop(void)
       // 16usec ticks that will be left in this
       // tdm state after this packet is transmitted
       
-#ifdef INCLUDE_AES
-      if (aes_get_encryption_level() > 0) {
-        // Calculation here gives length of cipher text (= same length of padded block)
-        trailer.window = (uint16_t)(tdm_state_remaining - flight_time_estimate(16 * (1 + (len+sizeof(trailer)>>4))));
-      } else {
-        trailer.window = (uint16_t)(tdm_state_remaining - flight_time_estimate(len+sizeof(trailer)));		
-      }
-#else // INCLUDE_AES
+      // len is the cipher text length when encrypting
       trailer.window = (uint16_t)(tdm_state_remaining - flight_time_estimate(len+sizeof(trailer)));
-#endif // INCLUDE_AES
     }
     
     // set right transmit channel
     radio_set_channel(fhop_transmit_channel());
     
     memcpy(&pbuf[len], &trailer, sizeof(trailer));
+    if (tx_crc_known && (feature_golay || feature_rs)) {
+      // carry the CRC on over the trailer, so the golay or
+      // Reed-Solomon encoding doesn't read the packet again
+      radio_transmit_crc(crc16_copy(sizeof(trailer), &pbuf[len], &pbuf[len], tx_crc));
+    }
     
     if (len != 0 && trailer.window != 0) {
       // show the user that we're sending real data
@@ -824,10 +1174,19 @@ tdm_serial_loop(void)
     }
     
     // start transmitting the packet
+#ifdef LATENCY_MEASURE
+    latency_tx_start();
+#endif
     if (!radio_transmit(len + sizeof(trailer), pbuf, tdm_state_remaining + (silence_period/2)) &&
-        len != 0 && trailer.window != 0 && trailer.command == 0) {
+        len != 0 && trailer.window != 0 && trailer.command == 0 &&
+        !tx_parity) {
+      // a lost parity packet isn't resent. Forcing a resend
+      // would send the last data packet again instead
       packet_force_resend();
     }
+#ifdef LATENCY_MEASURE
+    latency_tx_done();
+#endif
     
     if (lbt_rssi != 0) {
       // reset the LBT listen time
@@ -839,23 +1198,6 @@ tdm_serial_loop(void)
       LED_ACTIVITY = LED_OFF;
     }
 
-#ifdef INCLUDE_AES
-    // If we have any packets that need decrypting lets do it now.
-    if(tdm_state_remaining > tx_window_width/2)
-    {
-       // If it is starting to get really full, we want to try decrypting
-       // not just one, but a few packets.
-       if (encrypt_buffer_getting_full()) {
-          while (!encrypt_buffer_getting_empty()) {
-            decryptPackets();
-          }
-       } else {
-         decryptPackets();
-       }
-    }
-#endif // INCLUDE_AES
-
-
     // set right receive channel
     radio_set_channel(fhop_receive_channel());
     
@@ -927,20 +1269,45 @@ tdm_build_timing_table(void)
 
 
 // test hardware CRC code
+// needs CRC_TEST defined so the table version is built to compare with
 static void 
 crc_test(void)
 {
   __xdata uint8_t d[4] = { 0x01, 0x00, 0xbb, 0xcc };
   __pdata uint16_t crc;
-  uint16_t t1, t2;
+  uint16_t t1, t2, t3;
+  uint8_t i, i2, len, errors = 0;
   crc = crc16(4, &d[0]);
-  printf("CRC: %x %x\n", crc, 0xb166);	
+  printf("CRC: %x %x\n", crc, crc16_table(4, &d[0]));
+
+  // cross check against the tables with random contents and lengths
+  for (i=0; i<200; i++) {
+    len = ((uint8_t)rand()) % MAX_PACKET_LENGTH;
+    for (t1=0; t1<len; t1++) {
+      pbuf[t1] = rand();
+    }
+    if (crc16(len, pbuf) != crc16_table(len, pbuf)) {
+      printf("crc mismatch len=%u\n", (unsigned)len);
+      errors++;
+    }
+    // and the same CRC carried on over two pieces
+    i2 = len ? ((uint8_t)rand()) % len : 0;
+    crc = crc16_copy(i2, pbuf, pbuf, 0);
+    if (crc16_copy(len - i2, &pbuf[i2], &pbuf[i2], crc) != crc16_table(len, pbuf)) {
+      printf("crc copy mismatch len=%u split=%u\n", (unsigned)len, (unsigned)i2);
+      errors++;
+    }
+  }
+  printf("crc %u errors\n", (unsigned)errors);
+
   t1 = timer2_tick();
   crc16(MAX_PACKET_LENGTH/2, pbuf);
   t2 = timer2_tick();
-  printf("crc %u bytes took %u 16usec ticks\n",
+  crc16_table(MAX_PACKET_LENGTH/2, pbuf);
+  t3 = timer2_tick();
+  printf("crc %u bytes took %u 16usec ticks, tables %u\n",
         (unsigned)MAX_PACKET_LENGTH/2,
-        t2-t1);
+        t2-t1, t3-t2);
 }
 
 // test golay encoding
@@ -1009,6 +1376,23 @@ tdm_init(void)
 
 		// and adds 4 bytes
 		packet_latency += 4*ticks_per_byte;
+
+		if (feature_golay_interleave) {
+			// interleaving sends whole groups of 8 words, 12
+			// bytes of data, so pads by up to 21 bytes on air
+			max_data_packet_length = (MAX_PACKET_LENGTH/24)*12 - (6+sizeof(trailer));
+			packet_latency += 11*ticks_per_byte;
+		}
+	} else if (feature_rs) {
+		// the most that fits with its parity, less the network
+		// ID, length and CRC
+		max_data_packet_length = MAX_PACKET_LENGTH - RS_CODED_BLOCKS(MAX_PACKET_LENGTH)*RS_PARITY - (5+sizeof(trailer));
+
+		// Reed-Solomon adds RS_PARITY bytes per RS_BLOCK
+		ticks_per_byte = (ticks_per_byte*(RS_BLOCK+RS_PARITY) + RS_BLOCK-1) / RS_BLOCK;
+
+		// and the header and up to a block's parity more
+		packet_latency += (5+RS_PARITY)*ticks_per_byte;
 	} else {
 		max_data_packet_length = MAX_PACKET_LENGTH - sizeof(trailer);
 	}
@@ -1049,6 +1433,9 @@ tdm_init(void)
 	// length, so we get the right flight time estimates, while
 	// not changing the round timings
 	packet_latency += ((settings.preamble_length-10)/2) * ticks_per_byte;
+#if USE_SHORT_PREAMBLE
+	packet_latency_long = packet_latency;
+#endif
 
 	// tell the packet subsystem our max packet size, which it
 	// needs to know for MAVLink packet boundary detection
@@ -1077,5 +1464,12 @@ tdm_report_timing(void)
   printf("silence_period: %u\n", (unsigned)silence_period); delay_msec(1);
   printf("tx_window_width: %u\n", (unsigned)tx_window_width); delay_msec(1);
   printf("max_data_packet_length: %u\n", (unsigned)max_data_packet_length); delay_msec(1);
+#if USE_IDLE_SLEEP
+  printf("idle: %u%%\n", (unsigned)idle_percent); delay_msec(1);
+#endif
+#ifdef INCLUDE_AES
+  printf("decrypt_ticks: %u\n", (unsigned)decrypt_ticks); delay_msec(1);
+  printf("decrypt_queue: %u\n", (unsigned)serial_decrypt_depth()); delay_msec(1);
+#endif
 }
 
@@ -35,7 +35,7 @@
 static __data volatile uint8_t delay_counter;
 
 /// high 16 bits of timer2 SYSCLK/12 interrupt
-static __data volatile uint16_t timer2_high;
+__data volatile uint16_t timer2_high;
 
 
 INTERRUPT(T3_ISR, INTERRUPT_TIMER3)
@@ -43,8 +43,15 @@ INTERRUPT(T3_ISR, INTERRUPT_TIMER3)
 	// re-arm the interrupt by clearing TF3H
 	TMR3CN = 0x04;
 
-	// call the AT parser tick
-	at_timer();
+	// time since the last serial byte, for the +++ detector. The
+	// UART interrupt can preempt us, so it only flags a byte and
+	// this is the one place serial_rx_idle is written
+	if (serial_rx_seen) {
+		serial_rx_seen = false;
+		serial_rx_idle = 0;
+	} else if (serial_rx_idle != 0xFF) {
+		serial_rx_idle++;
+	}
 
 	// update the delay counter
 	if (delay_counter > 0)
@@ -82,14 +89,45 @@ delay_msec(register uint16_t msec)
 }
 
 
+// timer0 interrupt, used to wake the CPU from IDLE
+INTERRUPT(T0_ISR, INTERRUPT_TIMER0)
+{
+	// one shot, TF0 is cleared by hardware
+	TR0 = 0;
+}
+
+// arrange for a timer0 interrupt in the given number of 16usec ticks
+// timer0 counts at SYSCLK, so this is limited to TIMER_WAKE_MAX_TICKS
+void
+timer_wake_set(register uint16_t ticks)
+{
+	register uint16_t count;
+
+	if (ticks > TIMER_WAKE_MAX_TICKS) {
+		ticks = TIMER_WAKE_MAX_TICKS;
+	}
+	count = 0 - (ticks * TIMER_WAKE_SYSCLK_PER_TICK);
+	TR0 = 0;
+	TL0 = count & 0xff;
+	TH0 = count >> 8;
+	TR0 = 1;
+}
+
 // timer2 interrupt called every 32768 microseconds
 INTERRUPT(T2_ISR, INTERRUPT_TIMER2)
 {
+	// the UART interrupt can preempt us and timestamps bytes with
+	// timer2_high, checking TF2H for a wrap not yet counted. Keep
+	// it out until both are consistent again
+	__bit ES_saved = ES0;
+	ES0 = 0;
+
 	// re-arm the interrupt by clearing TF2H
 	TMR2CN = 0x04;
 
 	// increment the high 16 bits
 	timer2_high++;
+	ES0 = ES_saved;
 
 	if (feature_rtscts) {
 		serial_check_rts();
@@ -141,6 +179,33 @@ timer2_tick(void)
 	return (high<<11) | (low>>5);
 }
 
+// return timer2_tick() extended to 27 bits, which rolls over in
+// approximately 36 minutes
+uint32_t
+timer2_tick32(void)
+{
+	register uint16_t low, high;
+	do {
+		high = timer2_high;
+		low = timer2_16();
+	} while (high != timer2_high);
+	return (((uint32_t)high)<<11) | (low>>5);
+}
+
+// return a 16 bit value in units of 1.003 msec (2048 counts at
+// SYSCLK/12), which rolls over in approximately 65 seconds
+uint16_t
+timer2_msec(void)
+{
+	register uint16_t low, high;
+	do {
+		high = timer2_high;
+		low = timer2_16();
+	} while (high != timer2_high);
+	// each timer2_high period is 32 of these units
+	return (high<<5) | (low>>11);
+}
+
 // initialise timers
 void 
 timer_init(void)
@@ -157,6 +222,12 @@ timer_init(void)
 	TMR2RLH = 0;
 	TMR2CN  = 0x04; // start running, count at SYSCLK/12
 	ET2 = 1;
+
+	// setup TMR0 as a 16 bit one shot wakeup timer at SYSCLK. The
+	// serial code owns the prescaler, so don't use it
+	TMOD	= (TMOD & ~0x0f) | 0x01;
+	CKCON	|= 0x04;
+	ET0 = 1;
 }
 
 // return some entropy
@@ -27,6 +27,10 @@
 // OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+/// timer2 overflow count, the high 16 bits of the timer2 counter.
+/// Incremented by the timer2 interrupt every 32768 microseconds
+extern __data volatile uint16_t timer2_high;
+
 /// return the 16 bit timer2 counter
 ///
 /// @return		timer counter, in 0.5usec units
@@ -45,11 +49,38 @@ extern uint32_t micros(void);
 ///
 extern uint16_t timer2_tick(void);
 
+/// return timer2_tick() extended to 27 bits, for timing intervals
+/// longer than a second
+///
+/// @return		value in units of 16 microseconds
+///
+extern uint32_t timer2_tick32(void);
+
+/// return a 16 bit value that rolls over in approximately
+/// 65 second intervals
+///
+/// @return		16 bit value in units of about 1 millisecond
+///
+extern uint16_t timer2_msec(void);
+
 
 /// initialise timers
 ///
 extern void timer_init(void);
 
+/// SYSCLK cycles in one timer2_tick() unit (32 counts at SYSCLK/12)
+#define TIMER_WAKE_SYSCLK_PER_TICK	384U
+
+/// longest wakeup that timer0 can give us, in 16usec ticks
+#define TIMER_WAKE_MAX_TICKS		(65535U / TIMER_WAKE_SYSCLK_PER_TICK)
+
+/// arrange for an interrupt after a number of 16usec ticks, to wake
+/// the CPU from IDLE
+///
+/// @param ticks		Number of ticks, at most TIMER_WAKE_MAX_TICKS
+///
+extern void timer_wake_set(register uint16_t ticks);
+
 /// Set the delay timer
 ///
 /// @note Maximum delay is ~2.5sec in the current implementation.
@@ -0,0 +1,2 @@
+// Si1020_defs.h for the host build of the AES code. Everything the AES
+// code needs from it is in aes_host.h, which is included first
@@ -0,0 +1,162 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	aes_host.h
+///
+/// Host build environment for the radio AES code
+///
+/// This is included ahead of every firmware source built into the host
+/// tool (gcc -include). It stands in for compiler_defs.h, Si1020_defs.h
+/// and the parts of radio.h the AES code uses. The SFRs the AES code
+/// touches become accesses to the peripheral model in aes_model.c.
+///
+/// The firmware passes xdata addresses to the DMA as 16 bits. The model
+/// maps them back to the program's data and bss, so everything the
+/// firmware hands to the DMA must be a static or global, as it is on
+/// the radio. The data and bss together must fit in 64k.
+///
+
+#ifndef _AES_HOST_H_
+#define _AES_HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// stop the firmware's own headers being pulled in
+#define COMPILER_DEFS_H
+#define _RADIO_H_
+
+// SDCC storage classes
+#define __data
+#define __idata
+#define __pdata
+#define __xdata
+#define __code
+#define __bit		bool
+#define __reentrant
+#define __critical
+
+// compiler_defs.h
+#define SEG_XDATA
+#define SEG_CODE
+#define SEGMENT_VARIABLE(name, vartype, locsegment) locsegment vartype name
+#define VARIABLE_SEGMENT_POINTER(name, vartype, targsegment) targsegment vartype * name
+#define INTERRUPT(name, vector) void name (void)
+#define LSB 0
+#define MSB 1
+
+typedef uint8_t U8;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef int8_t S8;
+typedef int16_t S16;
+
+typedef union UU16
+{
+	U16 U16;
+	S16 S16;
+	U8 U8[2];
+	S8 S8[2];
+} UU16;
+
+// Si1020_defs.h. Each SFR is an lvalue in the model, and every access
+// is counted. The DMA0N registers are those of the channel DMA0SEL
+// picks, and reading DMA0INT lets the engine run, as that is what the
+// firmware polls for completion
+#define DPPE_PAGE	0x02
+#define INTERRUPT_DMA0	19
+
+struct aes_model_channel {
+	uint8_t	ncf, md;
+	uint8_t	bal, bah;
+	uint8_t	szl, szh;
+	uint8_t	aol, aoh;
+};
+
+struct aes_model_sfr {
+	uint8_t	sfrpage;
+	uint8_t	aes0bcfg, aes0dcfg;
+	uint8_t	dma0en, dma0sel, dma0int;
+	uint8_t	eie2, pcon;
+	struct aes_model_channel ch[8];
+};
+
+extern struct aes_model_sfr aes_model_sfr;
+extern uint32_t aes_model_sfr_accesses;
+extern uint8_t *aes_model_dma0int(void);
+
+#define AES_MODEL_SFR(_r)	(*(aes_model_sfr_accesses++, &aes_model_sfr._r))
+#define AES_MODEL_DMA0N(_r)	(*(aes_model_sfr_accesses++, &aes_model_sfr.ch[aes_model_sfr.dma0sel & 7]._r))
+
+#define SFRPAGE		AES_MODEL_SFR(sfrpage)
+#define AES0BCFG	AES_MODEL_SFR(aes0bcfg)
+#define AES0DCFG	AES_MODEL_SFR(aes0dcfg)
+#define DMA0EN		AES_MODEL_SFR(dma0en)
+#define DMA0SEL		AES_MODEL_SFR(dma0sel)
+#define EIE2		AES_MODEL_SFR(eie2)
+#define PCON		AES_MODEL_SFR(pcon)
+#define DMA0NCF		AES_MODEL_DMA0N(ncf)
+#define DMA0NMD		AES_MODEL_DMA0N(md)
+#define DMA0NBAL	AES_MODEL_DMA0N(bal)
+#define DMA0NBAH	AES_MODEL_DMA0N(bah)
+#define DMA0NSZL	AES_MODEL_DMA0N(szl)
+#define DMA0NSZH	AES_MODEL_DMA0N(szh)
+#define DMA0NAOL	AES_MODEL_DMA0N(aol)
+#define DMA0NAOH	AES_MODEL_DMA0N(aoh)
+#define DMA0INT		(*aes_model_dma0int())
+
+// radio.h
+#define MAX_PACKET_LENGTH 252
+
+extern __xdata uint8_t *param_get_encryption_key();
+extern uint8_t radio_current_rssi(void);
+
+// count the bytes the CPU copies or fills, which is per packet
+// overhead on the radio
+extern uint32_t aes_model_copy_bytes;
+#define memcpy(_d, _s, _n)	(aes_model_copy_bytes += (_n), memcpy((_d), (_s), (_n)))
+#define memset(_d, _c, _n)	(aes_model_copy_bytes += (_n), memset((_d), (_c), (_n)))
+
+/// Reset the peripheral model and its counters
+extern void aes_model_reset(void);
+
+/// Engine blocks processed, DMA bytes moved and DMA transfers the
+/// firmware waited for since aes_model_reset()
+extern uint32_t aes_model_blocks;
+extern uint32_t aes_model_dma_bytes;
+extern uint32_t aes_model_waits;
+
+/// Software AES, for checking the model against
+extern void aes_model_encrypt_block(const uint8_t *key, uint8_t key_len,
+				    const uint8_t *in, uint8_t *out);
+
+#endif // _AES_HOST_H_
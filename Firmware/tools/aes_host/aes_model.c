@@ -0,0 +1,461 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	aes_model.c
+///
+/// Software model of the Si102x/3x AES engine and its DMA channels
+///
+/// The engine takes a key from the AES0KIN channel, a block from
+/// AES0BIN and, when AES0DCFG asks for an XOR, a block from AES0XIN.
+/// The result goes out through AES0YOUT. Each channel moves bytes
+/// between its base address plus offset and the engine, stops when the
+/// offset reaches the size (or wraps, if DMA0NMD says so) and then
+/// sets its DMA0INT bit. A key taken from AES0KIN stays loaded while
+/// the engine is enabled, so a channel that has finished doesn't stall
+/// it. Disabling the engine drops the key and any output not yet
+/// written.
+///
+/// With AES0DCFG INVERSE_KEY the engine writes out the decryption key
+/// instead of a block. Here that is the last key length of the
+/// expanded key schedule, and decrypting runs the schedule backwards
+/// from it. The extended part of a 192 or 256 bit key comes out first,
+/// matching where GenerateDecryptionKey() points the DMA. The silicon
+/// may lay the key out differently; only the firmware's handling of
+/// the DMA has to match.
+///
+
+#include "aes_host.h"
+#include "../../radio/AES/AES_defs.h"
+#include "../../radio/AES/DMA_defs.h"
+
+// the model's own copies aren't the firmware's
+#undef memcpy
+#undef memset
+
+struct aes_model_sfr aes_model_sfr;
+uint32_t aes_model_sfr_accesses;
+uint32_t aes_model_copy_bytes;
+uint32_t aes_model_blocks;
+uint32_t aes_model_dma_bytes;
+uint32_t aes_model_waits;
+
+// start and end of data and bss, from the linker
+extern char __data_start[], _end[];
+
+static uint8_t	sbox[256], inv_sbox[256];
+static uint8_t	rcon[16];
+
+static uint8_t	engine_key[32];
+static bool	engine_key_valid;
+static uint8_t	engine_out[32];
+static uint8_t	engine_out_len, engine_out_pos;
+
+static uint8_t
+xtime(uint8_t x)
+{
+	return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+}
+
+static uint8_t
+gmul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+
+	while (b) {
+		if (b & 1) {
+			r ^= a;
+		}
+		a = xtime(a);
+		b >>= 1;
+	}
+	return r;
+}
+
+// build the S-boxes from the field inverse and the affine transform
+static void
+aes_tables(void)
+{
+	uint16_t i;
+	uint8_t x, inv, s;
+
+	for (i = 0; i < 256; i++) {
+		inv = 0;
+		if (i != 0) {
+			for (x = 1; gmul(i, x) != 1; x++)
+				;
+			inv = x;
+		}
+		s = inv;
+		s ^= (inv << 1) | (inv >> 7);
+		s ^= (inv << 2) | (inv >> 6);
+		s ^= (inv << 3) | (inv >> 5);
+		s ^= (inv << 4) | (inv >> 4);
+		sbox[i] = s ^ 0x63;
+		inv_sbox[sbox[i]] = i;
+	}
+	rcon[1] = 1;
+	for (i = 2; i < sizeof(rcon); i++) {
+		rcon[i] = xtime(rcon[i - 1]);
+	}
+}
+
+// the word the key schedule XORs into word i
+static void
+schedule_temp(uint8_t *t, const uint8_t *prev, uint8_t i, uint8_t nk)
+{
+	uint8_t j;
+
+	if (i % nk == 0) {
+		t[0] = sbox[prev[1]] ^ rcon[i / nk];
+		t[1] = sbox[prev[2]];
+		t[2] = sbox[prev[3]];
+		t[3] = sbox[prev[0]];
+	} else if (nk > 6 && i % nk == 4) {
+		for (j = 0; j < 4; j++) {
+			t[j] = sbox[prev[j]];
+		}
+	} else {
+		memcpy(t, prev, 4);
+	}
+}
+
+// expand a key forwards from the key itself, or backwards from the
+// last nk words of the schedule
+static uint8_t
+key_schedule(uint8_t w[60][4], const uint8_t *key, uint8_t key_len, bool inverse)
+{
+	uint8_t nk = key_len / 4;
+	uint8_t total = 4 * (nk + 7);
+	uint8_t i, j, t[4];
+
+	if (!inverse) {
+		memcpy(w, key, key_len);
+		for (i = nk; i < total; i++) {
+			schedule_temp(t, w[i - 1], i, nk);
+			for (j = 0; j < 4; j++) {
+				w[i][j] = w[i - nk][j] ^ t[j];
+			}
+		}
+	} else {
+		memcpy(w[total - nk], key, key_len);
+		for (i = total - 1; i >= nk; i--) {
+			schedule_temp(t, w[i - 1], i, nk);
+			for (j = 0; j < 4; j++) {
+				w[i - nk][j] = w[i][j] ^ t[j];
+			}
+		}
+	}
+	return nk + 6;
+}
+
+static void
+add_round_key(uint8_t *s, uint8_t w[60][4], uint8_t round)
+{
+	uint8_t i;
+
+	for (i = 0; i < 16; i++) {
+		s[i] ^= w[round * 4 + i / 4][i % 4];
+	}
+}
+
+static void
+encrypt_block(uint8_t w[60][4], uint8_t rounds, const uint8_t *in, uint8_t *out)
+{
+	uint8_t s[16], t[16];
+	uint8_t r, c, i;
+
+	memcpy(s, in, 16);
+	add_round_key(s, w, 0);
+	for (r = 1; r <= rounds; r++) {
+		// SubBytes and ShiftRows
+		for (i = 0; i < 16; i++) {
+			t[i] = sbox[s[(i + 4 * (i % 4)) % 16]];
+		}
+		if (r != rounds) {
+			// MixColumns
+			for (c = 0; c < 16; c += 4) {
+				s[c]   = xtime(t[c]) ^ xtime(t[c+1]) ^ t[c+1] ^ t[c+2] ^ t[c+3];
+				s[c+1] = t[c] ^ xtime(t[c+1]) ^ xtime(t[c+2]) ^ t[c+2] ^ t[c+3];
+				s[c+2] = t[c] ^ t[c+1] ^ xtime(t[c+2]) ^ xtime(t[c+3]) ^ t[c+3];
+				s[c+3] = xtime(t[c]) ^ t[c] ^ t[c+1] ^ t[c+2] ^ xtime(t[c+3]);
+			}
+		} else {
+			memcpy(s, t, 16);
+		}
+		add_round_key(s, w, r);
+	}
+	memcpy(out, s, 16);
+}
+
+static void
+decrypt_block(uint8_t w[60][4], uint8_t rounds, const uint8_t *in, uint8_t *out)
+{
+	uint8_t s[16], t[16];
+	uint8_t r, c, i;
+
+	memcpy(s, in, 16);
+	for (r = rounds; r >= 1; r--) {
+		add_round_key(s, w, r);
+		if (r != rounds) {
+			// InvMixColumns
+			for (c = 0; c < 16; c += 4) {
+				t[c]   = gmul(s[c], 14) ^ gmul(s[c+1], 11) ^ gmul(s[c+2], 13) ^ gmul(s[c+3], 9);
+				t[c+1] = gmul(s[c], 9) ^ gmul(s[c+1], 14) ^ gmul(s[c+2], 11) ^ gmul(s[c+3], 13);
+				t[c+2] = gmul(s[c], 13) ^ gmul(s[c+1], 9) ^ gmul(s[c+2], 14) ^ gmul(s[c+3], 11);
+				t[c+3] = gmul(s[c], 11) ^ gmul(s[c+1], 13) ^ gmul(s[c+2], 9) ^ gmul(s[c+3], 14);
+			}
+			memcpy(s, t, 16);
+		}
+		// InvShiftRows and InvSubBytes
+		for (i = 0; i < 16; i++) {
+			t[(i + 4 * (i % 4)) % 16] = inv_sbox[s[i]];
+		}
+		memcpy(s, t, 16);
+	}
+	add_round_key(s, w, 0);
+	memcpy(out, s, 16);
+}
+
+void
+aes_model_encrypt_block(const uint8_t *key, uint8_t key_len, const uint8_t *in, uint8_t *out)
+{
+	uint8_t w[60][4];
+	uint8_t rounds;
+
+	rounds = key_schedule(w, key, key_len, false);
+	encrypt_block(w, rounds, in, out);
+}
+
+// turn a 16 bit DMA address back into a pointer into data or bss
+static uint8_t *
+xdata_ptr(uint16_t addr)
+{
+	uintptr_t lo = (uintptr_t)__data_start;
+	uintptr_t p = lo + (uint16_t)(addr - (uint16_t)lo);
+
+	if (p >= (uintptr_t)_end) {
+		return NULL;
+	}
+	return (uint8_t *)p;
+}
+
+// the enabled channel serving a peripheral request, if any
+static int8_t
+channel_for(uint8_t request)
+{
+	uint8_t i;
+
+	for (i = 0; i < 8; i++) {
+		if ((aes_model_sfr.dma0en & (1 << i)) &&
+		    (aes_model_sfr.ch[i].ncf & 0x0F) == request) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// bytes a channel can still move
+static uint16_t
+channel_remaining(int8_t n)
+{
+	struct aes_model_channel *c;
+	uint16_t size, offset;
+
+	if (n < 0) {
+		return 0;
+	}
+	c = &aes_model_sfr.ch[n];
+	if (c->md & WRAPPING) {
+		return 0xFFFF;
+	}
+	size = c->szl | (c->szh << 8);
+	offset = c->aol | (c->aoh << 8);
+	return offset < size ? size - offset : 0;
+}
+
+// move one byte through a channel, to or from xdata
+static void
+channel_move(int8_t n, uint8_t *b, bool write)
+{
+	struct aes_model_channel *c = &aes_model_sfr.ch[n];
+	uint16_t base = c->bal | (c->bah << 8);
+	uint16_t size = c->szl | (c->szh << 8);
+	uint16_t offset = c->aol | (c->aoh << 8);
+	uint8_t *p = xdata_ptr(base + offset);
+
+	if (write) {
+		if (p == NULL) {
+			fprintf(stderr, "DMA channel %d write to 0x%04x outside data and bss\n",
+				n, base + offset);
+			exit(1);
+		}
+		*p = *b;
+	} else {
+		*b = p ? *p : 0;
+	}
+	aes_model_dma_bytes++;
+
+	offset++;
+	if (offset >= size) {
+		aes_model_sfr.dma0int |= 1 << n;
+		if (c->md & WRAPPING) {
+			offset = 0;
+		}
+	}
+	c->aol = offset & 0xFF;
+	c->aoh = offset >> 8;
+}
+
+// run the engine until it needs something it can't get
+static void
+engine_run(void)
+{
+	struct aes_model_sfr *s = &aes_model_sfr;
+	int8_t k, b, x, y;
+	uint8_t key_len, i;
+	uint8_t in[16], xin[16];
+	uint8_t w[60][4];
+	uint8_t rounds;
+	bool use_x;
+
+	if (!(s->aes0bcfg & AES_ENABLE) || (s->aes0bcfg & 0x03) == 0x03) {
+		engine_key_valid = false;
+		engine_out_len = engine_out_pos = 0;
+		return;
+	}
+	key_len = ((s->aes0bcfg & 0x03) + 2) << 3;
+	use_x = (s->aes0dcfg & (XOR_ON_INPUT | XOR_ON_OUTPUT)) != 0;
+
+	for (;;) {
+		if (engine_out_pos < engine_out_len) {
+			y = channel_for(AES0YOUT_PERIPHERAL_REQUEST);
+			if (channel_remaining(y) == 0) {
+				return;
+			}
+			channel_move(y, &engine_out[engine_out_pos++], true);
+			continue;
+		}
+
+		// a new block needs the key, unless one is loaded, the
+		// block input and maybe the XOR input
+		k = channel_for(AES0KIN_PERIPHERAL_REQUEST);
+		b = channel_for(AES0BIN_PERIPHERAL_REQUEST);
+		x = channel_for(AES0XIN_PERIPHERAL_REQUEST);
+		if (channel_remaining(k) < key_len && !engine_key_valid) {
+			return;
+		}
+		if (channel_remaining(b) < 16 ||
+		    (use_x && channel_remaining(x) < 16)) {
+			return;
+		}
+		if (channel_remaining(k) >= key_len) {
+			for (i = 0; i < key_len; i++) {
+				channel_move(k, &engine_key[i], false);
+			}
+			engine_key_valid = true;
+		}
+		for (i = 0; i < 16; i++) {
+			channel_move(b, &in[i], false);
+		}
+		if (use_x) {
+			for (i = 0; i < 16; i++) {
+				channel_move(x, &xin[i], false);
+			}
+		}
+		aes_model_blocks++;
+
+		if (s->aes0dcfg & INVERSE_KEY) {
+			key_schedule(w, engine_key, key_len, false);
+			// the extended part first, then the first 16 bytes
+			memcpy(engine_out, &w[4 * (key_len / 4 + 7) - key_len / 4][0], key_len);
+			if (key_len > 16) {
+				memcpy(in, engine_out, 16);
+				memmove(engine_out, &engine_out[16], key_len - 16);
+				memcpy(&engine_out[key_len - 16], in, 16);
+			}
+			engine_out_len = key_len;
+			engine_out_pos = 0;
+			continue;
+		}
+
+		if (s->aes0dcfg & XOR_ON_INPUT) {
+			for (i = 0; i < 16; i++) {
+				in[i] ^= xin[i];
+			}
+		}
+		if (s->aes0bcfg & ENCRYPTION_MODE) {
+			rounds = key_schedule(w, engine_key, key_len, false);
+			encrypt_block(w, rounds, in, engine_out);
+		} else {
+			rounds = key_schedule(w, engine_key, key_len, true);
+			decrypt_block(w, rounds, in, engine_out);
+		}
+		if (s->aes0dcfg & XOR_ON_OUTPUT) {
+			for (i = 0; i < 16; i++) {
+				engine_out[i] ^= xin[i];
+			}
+		}
+		engine_out_len = 16;
+		engine_out_pos = 0;
+	}
+}
+
+uint8_t *
+aes_model_dma0int(void)
+{
+	uint8_t before = aes_model_sfr.dma0int;
+
+	aes_model_sfr_accesses++;
+	engine_run();
+	if ((aes_model_sfr.dma0int & ~before) & AES0YOUT_MASK) {
+		aes_model_waits++;
+	}
+	return &aes_model_sfr.dma0int;
+}
+
+void
+aes_model_reset(void)
+{
+	if (_end - __data_start > 0x10000) {
+		fprintf(stderr, "data and bss are %ld bytes, more than a 16 bit DMA address reaches\n",
+			(long)(_end - __data_start));
+		exit(1);
+	}
+	if (sbox[0] == 0) {
+		aes_tables();
+	}
+	memset(&aes_model_sfr, 0, sizeof(aes_model_sfr));
+	engine_key_valid = false;
+	engine_out_len = engine_out_pos = 0;
+	aes_model_sfr_accesses = 0;
+	aes_model_copy_bytes = 0;
+	aes_model_blocks = 0;
+	aes_model_dma_bytes = 0;
+	aes_model_waits = 0;
+}
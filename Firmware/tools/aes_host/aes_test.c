@@ -0,0 +1,393 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	aes_test.c
+///
+/// Known answer tests and benchmark for the radio AES code, run on
+/// the host against the peripheral model in aes_model.c
+///
+/// With no arguments this runs the FIPS-197 and SP 800-38A known
+/// answer tests through the Silicon Labs wrappers, then checks
+/// aes_encrypt()/aes_decrypt() at every encryption level and packet
+/// length. It exits non-zero on any failure.
+///
+/// "aes_host bench" times aes_encrypt() and aes_decrypt() for each
+/// encryption level and a range of packet lengths. Host time only
+/// compares one version of the code with another. The per packet
+/// counts of SFR accesses, DMA waits and bytes copied by the CPU are
+/// what costs time on the radio outside the engine itself.
+///
+
+#include <time.h>
+#include "../../radio/timer.h"
+#include "../../radio/AES/aes.h"
+#include "../../radio/AES/AES_BlockCipher.h"
+#include "../../radio/AES/CBC_EncryptDecrypt.h"
+#include "../../radio/AES/CTR_EncryptDecrypt.h"
+#include "../../radio/AES/GenerateDecryptionKey.h"
+
+#undef memcpy
+#undef memset
+
+// everything the DMA sees must be static, as on the radio
+static uint8_t key[32];
+static uint8_t dkey[32];
+static uint8_t iv[16];
+static uint8_t in[MAX_PACKET_LENGTH + 16];
+// aes_encrypt() needs 16 bytes before its output, like pbuf
+static uint8_t out_space[16 + MAX_PACKET_LENGTH + 16];
+#define out (&out_space[16])
+static uint8_t back[MAX_PACKET_LENGTH + 16];
+
+static unsigned failures;
+
+// stand ins for the rest of the firmware
+static uint32_t fake_tick;
+
+__xdata uint8_t *
+param_get_encryption_key()
+{
+	return key;
+}
+
+uint8_t
+radio_current_rssi(void)
+{
+	return 0;
+}
+
+uint32_t
+timer2_tick32(void)
+{
+	return fake_tick += 7919;
+}
+
+uint8_t
+timer_entropy(void)
+{
+	return 0;
+}
+
+static void
+hex(uint8_t *buf, const char *s)
+{
+	unsigned v;
+
+	while (sscanf(s, "%2x", &v) == 1) {
+		*buf++ = v;
+		s += 2;
+	}
+}
+
+static void
+check(bool ok, const char *what, unsigned arg)
+{
+	if (!ok) {
+		printf("FAIL: %s (%u)\n", what, arg);
+		failures++;
+	}
+}
+
+static bool
+check_hex(const uint8_t *buf, const char *s)
+{
+	static uint8_t want[80];
+	uint8_t n = strlen(s) / 2;
+
+	hex(want, s);
+	return memcmp(buf, want, n) == 0;
+}
+
+// FIPS-197 appendix C
+static const char *fips_key[3] = {
+	"000102030405060708090a0b0c0d0e0f",
+	"000102030405060708090a0b0c0d0e0f1011121314151617",
+	"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+};
+static const char *fips_ct[3] = {
+	"69c4e0d86a7b0430d8cdb78070b4c55a",
+	"dda97ca4864cdfe06eaf70a0ec0d7191",
+	"8ea2b7ca516745bfeafc49904b496089",
+};
+#define FIPS_PT "00112233445566778899aabbccddeeff"
+
+// SP 800-38A F.2 and F.5
+static const char *sp_key[3] = {
+	"2b7e151628aed2a6abf7158809cf4f3c",
+	"8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b",
+	"603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+};
+#define SP_PT	"6bc1bee22e409f96e93d7e117393172a" \
+		"ae2d8a571e03ac9c9eb76fac45af8e51" \
+		"30c81c46a35ce411e5fbc1191a0a52ef" \
+		"f69f2445df4f9b17ad2b417be66c3710"
+#define SP_IV	"000102030405060708090a0b0c0d0e0f"
+#define SP_CTR	"f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+static const char *sp_cbc[3] = {
+	"7649abac8119b246cee98e9b12e9197d" "5086cb9b507219ee95db113a917678b2"
+	"73bed6b8e3c1743b7116e69e22229516" "3ff1caa1681fac09120eca307586e1a7",
+	"4f021db243bc633d7178183a9fa071e8" "b4d9ada9ad7dedf4e5e738763f69145a"
+	"571b242012fb7ae07fa9baac3df102e0" "08b0e27988598881d920a9e64f5615cd",
+	"f58c4c04d6e5f1ba779eabfb5f7bfbd6" "9cfc4e967edb808d679f777bc6702c7d"
+	"39f23369a9d9bacfa530e26304231461" "b2eb05e2c39be9fcda6c19078c6a9d1b",
+};
+static const char *sp_ctr[3] = {
+	"874d6191b620e3261bef6864990db6ce" "9806f66b7970fdff8617187bb9fffdff"
+	"5ae4df3edbd5d35e5b4f09020db03eab" "1e031dda2fbe03d1792170a0f3009cee",
+	"1abc932417521ca24f2b0459fe7e6e0b" "090339ec0aa6faefd5ccc2c6f4ce8e94"
+	"1e36b26bd1ebc670d1bd1d665620abf7" "4f78a7f6d29809585a97daec58c6b050",
+	"601ec313775789a5b7a7f504bbf3d228" "f443e3ca4d62b59aca84e990cacaf5c5"
+	"2b0930daa23de94ce87017ba2d84988d" "dfc9c58db67aada613c2dd08457941a6",
+};
+
+// the wrappers on their own, against the published vectors
+static void
+test_vectors(void)
+{
+	uint8_t k;
+
+	for (k = 0; k < 3; k++) {
+		aes_model_reset();
+
+		// single blocks, and the decryption key
+		hex(key, fips_key[k]);
+		hex(in, FIPS_PT);
+		aes_model_encrypt_block(key, 16 + 8 * k, in, back);
+		check(check_hex(back, fips_ct[k]), "FIPS-197 software model", k);
+		check(AES_BlockCipher(ENCRYPTION_128_BITS + k, in, out, key, 1) == 0 &&
+		      check_hex(out, fips_ct[k]), "FIPS-197 AES_BlockCipher encrypt", k);
+		check(GenerateDecryptionKey(key, dkey, k) == 0, "GenerateDecryptionKey", k);
+		memset(back, 0, 16);
+		check(AES_BlockCipher(DECRYPTION_128_BITS + k, back, out, dkey, 1) == 0 &&
+		      check_hex(back, FIPS_PT), "FIPS-197 AES_BlockCipher decrypt", k);
+
+		// CBC, 4 blocks
+		hex(key, sp_key[k]);
+		hex(in, SP_PT);
+		hex(iv, SP_IV);
+		GenerateDecryptionKey(key, dkey, k);
+		check(CBC_EncryptDecrypt(ENCRYPTION_128_BITS + k, in, out, iv, key, 4) == 0 &&
+		      check_hex(out, sp_cbc[k]), "SP 800-38A CBC encrypt", k);
+		memset(back, 0, 64);
+		check(CBC_EncryptDecrypt(DECRYPTION_128_BITS + k, back, out, iv, dkey, 4) == 0 &&
+		      check_hex(back, SP_PT), "SP 800-38A CBC decrypt", k);
+
+		// CTR, 4 blocks. The counter is advanced in place
+		hex(iv, SP_CTR);
+		check(CTR_EncryptDecrypt(ENCRYPTION_128_BITS + k, in, out, iv, key, 4) == 0 &&
+		      check_hex(out, sp_ctr[k]), "SP 800-38A CTR encrypt", k);
+		check(check_hex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdff02"), "CTR counter advance", k);
+		hex(iv, SP_CTR);
+		memset(back, 0, 64);
+		check(CTR_EncryptDecrypt(DECRYPTION_128_BITS + k, back, out, iv, key, 4) == 0 &&
+		      check_hex(back, SP_PT), "SP 800-38A CTR decrypt", k);
+	}
+}
+
+static const uint8_t levels[] = { 0x01, 0x02, 0x03, 0x11, 0x12, 0x13 };
+#define NUM_LEVELS (sizeof(levels) / sizeof(levels[0]))
+
+// check CTR cipher text in out against the software model
+static bool
+ctr_keystream(uint8_t l, uint8_t len)
+{
+	uint8_t block[16], ctr[16];
+	uint8_t i;
+
+	hex(ctr, SP_CTR);
+	memcpy(&ctr[8], &out[len], 6);
+	ctr[14] = ctr[15] = 0;
+	for (i = 0; i < len; i++) {
+		if ((i & 15) == 0) {
+			aes_model_encrypt_block(key, AES_KEY_LENGTH(levels[l]), ctr, block);
+			ctr[15]++;
+		}
+		if ((in[i] ^ block[i & 15]) != out[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// aes_encrypt() and aes_decrypt() as the radio uses them
+static void
+test_packets(void)
+{
+	uint8_t l, len, max, out_len, back_len, i;
+	static uint8_t first[MAX_PACKET_LENGTH];
+
+	for (l = 0; l < NUM_LEVELS; l++) {
+		aes_model_reset();
+		hex(key, sp_key[(levels[l] & 0xf) - 1]);
+		check(aes_init(levels[l]), "aes_init", levels[l]);
+
+		// the first CBC packet is SP 800-38A, plus a block of padding
+		hex(in, SP_PT);
+		if ((levels[l] >> 4) == 0) {
+			aes_encrypt(in, 64, out, &out_len);
+			check(out_len == 80 && check_hex(out, sp_cbc[(levels[l] & 0xf) - 1]),
+			      "aes_encrypt CBC vector", levels[l]);
+		} else {
+			// CTR is the SP 800-38A counter with the packet nonce
+			// in bytes 8-13. A part block must use a fresh
+			// counter too
+			aes_encrypt(in, 64, out, &out_len);
+			check(out_len == 70 && ctr_keystream(l, 64), "aes_encrypt CTR keystream", levels[l]);
+			aes_encrypt(in, 40, out, &out_len);
+			check(out_len == 46 && ctr_keystream(l, 40), "aes_encrypt CTR part block", levels[l]);
+		}
+
+		// every length that fits an air packet round trips, and
+		// nothing is written past the cipher text
+		max = aes_plaintext_room(MAX_PACKET_LENGTH);
+		for (len = 1; len <= max; len++) {
+			for (i = 0; i < len; i++) {
+				in[i] = len * 31 + i;
+			}
+			memset(out, 0xA5, MAX_PACKET_LENGTH + 16);
+			check(aes_encrypt(in, len, out, &out_len) == 0, "aes_encrypt", len);
+			check(out_len <= MAX_PACKET_LENGTH, "cipher text fits a packet", len);
+			check(out[out_len] == 0xA5, "aes_encrypt overrun", len);
+
+			// encrypting in place gives the same. This comes
+			// first, as decrypting our own CTR packet below
+			// looks like the other end using our epoch
+			memcpy(first, out, out_len);
+			memcpy(out, in, len);
+			aes_repeat_nonce();
+			aes_encrypt(out, len, out, &back_len);
+			check(back_len == out_len && memcmp(first, out, out_len) == 0,
+			      "in place", levels[l] * 256 + len);
+
+			memset(back, 0xA5, sizeof(back));
+			check(aes_decrypt(out, out_len, back, &back_len) == 0, "aes_decrypt", len);
+			check(back_len == len && memcmp(back, in, len) == 0,
+			      "round trip", levels[l] * 256 + len);
+		}
+
+		// a CTR resend gives the same cipher text, and only then
+		if ((levels[l] >> 4) == 1) {
+			aes_encrypt(in, 40, first, &out_len);
+			aes_repeat_nonce();
+			aes_encrypt(in, 40, out, &out_len);
+			check(memcmp(first, out, out_len) == 0, "aes_repeat_nonce", levels[l]);
+			aes_encrypt(in, 40, out, &out_len);
+			check(memcmp(first, out, out_len) != 0, "fresh nonce", levels[l]);
+
+			// receiving our own epoch moves us to a new one
+			aes_encrypt(in, 40, first, &out_len);
+			check(aes_decrypt(first, out_len, back, &back_len) == 0, "own epoch", levels[l]);
+			aes_encrypt(in, 40, out, &out_len);
+			check(memcmp(&first[40], &out[40], 4) != 0, "new epoch", levels[l]);
+		}
+
+		// anything that can't be cipher text is refused, not
+		// decrypted
+		check(aes_decrypt(in, 3, back, &back_len) != 0, "short packet", levels[l]);
+		if ((levels[l] >> 4) == 1) {
+			check(aes_decrypt(in, 6, back, &back_len) != 0, "bare nonce", levels[l]);
+		} else {
+			check(aes_decrypt(in, 17, back, &back_len) != 0, "part block", levels[l]);
+		}
+	}
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+bench(void)
+{
+	static const uint8_t lengths[] = { 16, 32, 64, 128, 200, 0 };
+	uint8_t l, n, len, out_len, back_len;
+	uint32_t i, iterations = 20000;
+	double t;
+
+	printf("%-6s %4s %5s %10s %8s %7s %7s %7s\n",
+	       "level", "len", "dir", "blocks/s", "us/pkt",
+	       "sfr/pkt", "wait/pkt", "copy/pkt");
+	for (l = 0; l < NUM_LEVELS; l++) {
+		hex(key, sp_key[(levels[l] & 0xf) - 1]);
+		aes_init(levels[l]);
+		for (n = 0; n < sizeof(lengths); n++) {
+			len = lengths[n] ? lengths[n] : aes_plaintext_room(MAX_PACKET_LENGTH);
+			for (i = 0; i < len; i++) {
+				in[i] = i;
+			}
+
+			aes_model_reset();
+			t = now();
+			for (i = 0; i < iterations; i++) {
+				aes_encrypt(in, len, out, &out_len);
+			}
+			t = now() - t;
+			printf("0x%02x   %4u %5s %10.0f %8.2f %7u %7u %7u\n",
+			       levels[l], len, "enc", aes_model_blocks / t, 1e6 * t / iterations,
+			       aes_model_sfr_accesses / iterations,
+			       aes_model_waits / iterations,
+			       aes_model_copy_bytes / iterations);
+
+			aes_model_reset();
+			t = now();
+			for (i = 0; i < iterations; i++) {
+				aes_decrypt(out, out_len, back, &back_len);
+			}
+			t = now() - t;
+			printf("0x%02x   %4u %5s %10.0f %8.2f %7u %7u %7u\n",
+			       levels[l], len, "dec", aes_model_blocks / t, 1e6 * t / iterations,
+			       aes_model_sfr_accesses / iterations,
+			       aes_model_waits / iterations,
+			       aes_model_copy_bytes / iterations);
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench();
+		return 0;
+	}
+
+	test_vectors();
+	test_packets();
+	if (failures != 0) {
+		printf("%u failures\n", failures);
+		return 1;
+	}
+	printf("all AES tests passed\n");
+	return 0;
+}
@@ -0,0 +1,467 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	golay_test.c
+///
+/// Tests and benchmark for the radio golay code, run on the host
+///
+/// golay.c is built twice, with the full tables and with
+/// GOLAY_COMPACT, and the compact build's functions are renamed to
+/// golay_compact_encode() and golay_compact_decode().
+///
+/// With no arguments this checks both encoders against a bit serial
+/// one, checks both decoders correct every error of up to 3 bits in
+/// a word, including when decoding in place as radio.c does, checks
+/// golay_deinterleave() undoes golay_interleave(), and checks the two
+/// decoders agree on every possible 23 bit word. It exits non-zero on
+/// any failure.
+///
+/// "golay_host bench" times encoding and decoding a full size golay
+/// payload with no errors and with 1 and 3 bit errors in every word.
+/// Host time only compares one version of the code with another. The
+/// table lookups per word are what costs time on the radio.
+///
+/// "golay_host burst" builds packets the way radio_transmit_golay()
+/// does, with PARAM_ECC 1 and 2, hits each with a burst of errors at a
+/// random place, decodes it the way radio_receive_packet() does, and
+/// prints the percentage of packets received against burst length.
+///
+
+#include <time.h>
+#include "../../radio/golay.h"
+#include "../../radio/golay23.h"
+#undef _GOLAY23_H_
+#define GOLAY_COMPACT
+#include "../../radio/golay23.h"
+
+extern void golay_compact_encode(__pdata uint8_t n, __xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out);
+extern uint8_t golay_compact_decode(__pdata uint8_t n, __xdata uint8_t * __pdata in, __xdata uint8_t * __pdata out);
+
+// the largest payload radio_transmit_golay() sends
+#define PAYLOAD (MAX_PACKET_LENGTH / 2)
+
+struct variant {
+	const char *name;
+	void (*encode)(uint8_t n, uint8_t *in, uint8_t *out);
+	uint8_t (*decode)(uint8_t n, uint8_t *in, uint8_t *out);
+	unsigned table_bytes;
+};
+
+static const struct variant variants[] = {
+	{ "full", golay_encode, golay_decode,
+	  sizeof(golay23_encode) + sizeof(golay23_decode) },
+	{ "compact", golay_compact_encode, golay_compact_decode,
+	  sizeof(golay23_encode_lo) + sizeof(golay23_encode_hi) +
+	  sizeof(golay23_rows) + sizeof(golay23_transpose_lo) +
+	  sizeof(golay23_transpose_hi) + sizeof(golay23_columns) +
+	  sizeof(golay23_weight) },
+};
+#define NUM_VARIANTS (sizeof(variants) / sizeof(variants[0]))
+
+static uint32_t error_patterns[2048];
+static unsigned failures;
+
+static void
+check(bool ok, const char *what, const char *name, uint32_t n)
+{
+	if (!ok) {
+		if (failures < 20) {
+			printf("FAIL %s %s 0x%06x\n", name, what, (unsigned)n);
+		}
+		failures++;
+	}
+}
+
+// the parity of a 12 bit word: the remainder of v.x^11 divided by the
+// generator x^11+x^10+x^6+x^5+x^4+x^2+1, a bit at a time
+static uint16_t
+parity_serial(uint16_t v)
+{
+	uint32_t r = (uint32_t)v << 11;
+	int8_t b;
+
+	for (b = 22; b >= 11; b--) {
+		if (r & (1UL << b)) {
+			r ^= 0xC75UL << (b - 11);
+		}
+	}
+	return r;
+}
+
+// the 23 bit codewords for 3 bytes are packed into 6 bytes, low byte
+// first, with the parity in bits 0-10 and the data in bits 11-22
+static void
+pack(uint8_t *out, uint32_t a, uint32_t b)
+{
+	out[0] = a; out[1] = a >> 8; out[2] = a >> 16;
+	out[3] = b; out[4] = b >> 8; out[5] = b >> 16;
+}
+
+static uint32_t
+codeword(uint16_t v)
+{
+	return ((uint32_t)v << 11) | parity_serial(v);
+}
+
+// every error of up to 3 bits in a 23 bit word
+static void
+make_error_patterns(void)
+{
+	unsigned n = 0;
+	uint8_t i, j, k;
+
+	error_patterns[n++] = 0;
+	for (i = 0; i < 23; i++) {
+		error_patterns[n++] = 1UL << i;
+		for (j = i + 1; j < 23; j++) {
+			error_patterns[n++] = (1UL << i) | (1UL << j);
+			for (k = j + 1; k < 23; k++) {
+				error_patterns[n++] = (1UL << i) | (1UL << j) | (1UL << k);
+			}
+		}
+	}
+}
+
+static void
+test_encode(void)
+{
+	uint8_t in[3], out[6], expect[6];
+	uint16_t v;
+	uint8_t n;
+
+	for (n = 0; n < NUM_VARIANTS; n++) {
+		for (v = 0; v < 4096; v++) {
+			// the first word is in[0] and the low half of in[1],
+			// the second in[2] and the high half of in[1]
+			in[0] = v;
+			in[1] = (v >> 8) | ((v ^ 0x5A) & 0xF0);
+			in[2] = (v ^ 0x5A) ^ 0xFF;
+			pack(expect, codeword(in[0] | (in[1] & 0x0F) << 8),
+			     codeword(in[2] | (in[1] & 0xF0) << 4));
+			variants[n].encode(3, in, out);
+			check(memcmp(out, expect, 6) == 0, "encode", variants[n].name, v);
+		}
+	}
+}
+
+static void
+test_correct(void)
+{
+	uint8_t in[6], out[3], errors;
+	uint16_t v, w;
+	uint32_t ea, eb;
+	unsigned k;
+	uint8_t n;
+
+	for (n = 0; n < NUM_VARIANTS; n++) {
+		for (v = 0; v < 4096; v++) {
+			w = v ^ 0xA5A;
+			for (k = 0; k < 2048; k++) {
+				ea = error_patterns[k];
+				eb = error_patterns[(k * 7 + 1) % 2048];
+				pack(in, codeword(v) ^ ea, codeword(w) ^ eb);
+				errors = variants[n].decode(6, in, out);
+				check(out[0] == (v & 0xFF) &&
+				      out[1] == ((v >> 8) | ((w >> 4) & 0xF0)) &&
+				      out[2] == (w & 0xFF),
+				      "correct", variants[n].name, (v << 11) | k);
+				// only errors in the data bits are counted
+				check(errors == ((ea >> 11) != 0) + ((eb >> 11) != 0),
+				      "error count", variants[n].name, (v << 11) | k);
+			}
+		}
+	}
+}
+
+static void
+test_agree(void)
+{
+	uint8_t in[6], out0[3], out1[3], e0, e1;
+	uint32_t r;
+
+	for (r = 0; r < (1UL << 23); r++) {
+		pack(in, r, r ^ 0x2AAAAA);
+		e0 = variants[0].decode(6, in, out0);
+		e1 = variants[1].decode(6, in, out1);
+		check(e0 == e1 && memcmp(out0, out1, 3) == 0, "agree", variants[1].name, r);
+	}
+}
+
+// radio_receive_packet() decodes the payload over the top of the
+// received packet, 12 bytes further on
+static void
+test_in_place(void)
+{
+	static uint8_t data[PAYLOAD], buf[12 + 2 * PAYLOAD];
+	uint16_t j;
+	uint8_t n, len;
+
+	for (n = 0; n < NUM_VARIANTS; n++) {
+		for (len = 3; len <= PAYLOAD - 6; len += 3) {
+			for (j = 0; j < len; j++) {
+				data[j] = rand();
+			}
+			variants[n].encode(len, data, &buf[12]);
+			for (j = 0; j < 2 * len; j += 3) {
+				buf[12 + j + (j % 7) % 3] ^= 1 << (j % 8);
+			}
+			variants[n].decode(2 * len, &buf[12], buf);
+			check(memcmp(buf, data, len) == 0, "in place", variants[n].name, len);
+		}
+	}
+}
+
+// every output byte holds one bit of each word, and the bytes go
+// stride apart
+static void
+test_interleave(void)
+{
+	static uint8_t in[24], air[24 * 10], out[24];
+	uint8_t stride, c, w, j;
+
+	for (stride = 1; stride <= 10; stride++) {
+		for (j = 0; j < 24; j++) {
+			in[j] = rand();
+		}
+		memset(air, 0, sizeof(air));
+		golay_interleave(in, &air[stride - 1], stride);
+		for (c = 0; c < 24; c++) {
+			uint8_t expect = 0;
+
+			for (w = 0; w < 8; w++) {
+				if (in[3 * w + c / 8] & (1 << (c % 8))) {
+					expect |= 1 << w;
+				}
+			}
+			check(air[stride - 1 + c * stride] == expect, "interleave", "full", c);
+		}
+		golay_deinterleave(&air[stride - 1], stride, out);
+		check(memcmp(in, out, 24) == 0, "deinterleave", "full", stride);
+	}
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+bench(void)
+{
+	static uint8_t data[PAYLOAD], coded[2 * PAYLOAD], back[PAYLOAD];
+	// errors in the data bits of each word, which the decoder has
+	// to correct
+	static const uint8_t bits[] = { 0, 1, 3 };
+	static const uint8_t mask[] = { 0x00, 0x08, 0x38 };
+	uint32_t i, iterations = 20000;
+	uint8_t n, b;
+	uint16_t j;
+	double t;
+
+	for (j = 0; j < PAYLOAD; j++) {
+		data[j] = j * 37;
+	}
+
+	printf("%-8s %6s %7s %10s %10s\n", "variant", "tables", "errors",
+	       "enc us/pkt", "dec us/pkt");
+	for (n = 0; n < NUM_VARIANTS; n++) {
+		for (b = 0; b < sizeof(bits); b++) {
+			double enc, dec;
+
+			t = now();
+			for (i = 0; i < iterations; i++) {
+				variants[n].encode(PAYLOAD, data, coded);
+			}
+			enc = now() - t;
+
+			for (j = 0; j < 2 * PAYLOAD; j += 3) {
+				coded[j + 1] ^= mask[b];
+			}
+
+			t = now();
+			for (i = 0; i < iterations; i++) {
+				variants[n].decode(2 * PAYLOAD, coded, back);
+			}
+			dec = now() - t;
+			check(memcmp(back, data, PAYLOAD) == 0, "bench decode", variants[n].name, bits[b]);
+
+			printf("%-8s %6u %7u %10.2f %10.2f\n", variants[n].name,
+			       variants[n].table_bytes, bits[b],
+			       1e6 * enc / iterations, 1e6 * dec / iterations);
+		}
+	}
+}
+
+// the packet radio_transmit_golay() sends for len bytes of data,
+// returning its length
+static uint8_t
+burst_send(bool interleave, uint8_t len, uint8_t *data, uint8_t *air)
+{
+	static uint8_t head[6], group[24];
+	uint8_t rlen = ((len + 2) / 3) * 3;
+	uint8_t groups, g, k, u;
+
+	head[0] = 0x12;
+	head[1] = 0x34;
+	head[2] = len;
+	head[3] = 0x56;
+	head[4] = 0x78;
+	head[5] = len;
+	if (!interleave) {
+		golay_encode(6, head, air);
+		golay_encode(rlen, data, &air[12]);
+		return (rlen + 6) * 2;
+	}
+	groups = GOLAY_INTERLEAVE_GROUPS((rlen + 6) * 2);
+	u = 0;
+	for (g = 0; g < groups; g++) {
+		for (k = 0; k < 24; k += 6) {
+			if (u < 2) {
+				golay_encode(3, &head[u * 3], &group[k]);
+			} else if ((u - 2) * 3 < rlen) {
+				golay_encode(3, &data[(u - 2) * 3], &group[k]);
+			} else {
+				memset(&group[k], 0, 6);
+			}
+			u++;
+		}
+		golay_interleave(group, &air[g], groups);
+	}
+	return groups * 24;
+}
+
+// decode a packet as radio_receive_packet() does, true if it gets
+// the header, CRC word and data back intact
+static bool
+burst_receive(bool interleave, uint8_t elen, uint8_t len, uint8_t *data, uint8_t *air)
+{
+	static uint8_t buf[MAX_PACKET_LENGTH], gout[3];
+	uint8_t clen, groups, g;
+
+	if (interleave) {
+		groups = elen / 24;
+		for (g = 0; g < groups; g++) {
+			golay_deinterleave(&air[g], groups, &buf[g * 24]);
+		}
+	} else {
+		memcpy(buf, air, elen);
+	}
+	golay_decode(6, buf, gout);
+	if (gout[0] != 0x12 || gout[1] != 0x34 || gout[2] != len) {
+		return false;
+	}
+	clen = 6 * ((len + 2) / 3 + 2);
+	golay_decode(6, &buf[6], gout);
+	if (gout[0] != 0x56 || gout[1] != 0x78) {
+		return false;
+	}
+	golay_decode(clen - 12, &buf[12], buf);
+	return memcmp(buf, data, len) == 0;
+}
+
+static void
+burst(void)
+{
+	static uint8_t data[PAYLOAD], air[MAX_PACKET_LENGTH];
+	// a short packet and the largest interleaved one
+	static const uint8_t lens[] = { 30, (MAX_PACKET_LENGTH / 24) * 12 - 6 };
+	static const uint16_t bursts[] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32,
+					   48, 64, 96, 128, 192, 240 };
+	uint32_t i, iterations = 5000;
+	uint8_t l, b, mode, elen;
+	uint16_t j;
+
+	printf("%5s", "burst");
+	for (l = 0; l < sizeof(lens); l++) {
+		printf("   ecc1 %3u   ecc2 %3u", lens[l], lens[l]);
+	}
+	printf("\n");
+
+	for (b = 0; b < sizeof(bursts) / sizeof(bursts[0]); b++) {
+		printf("%5u", bursts[b]);
+		for (l = 0; l < sizeof(lens); l++) {
+			for (mode = 0; mode < 2; mode++) {
+				uint32_t good = 0;
+
+				for (i = 0; i < iterations; i++) {
+					uint16_t start;
+
+					for (j = 0; j < lens[l]; j++) {
+						data[j] = rand();
+					}
+					elen = burst_send(mode, lens[l], data, air);
+
+					// a burst starts and ends with an error,
+					// and the bits between are random
+					start = rand() % (elen * 8 - bursts[b] + 1);
+					for (j = 0; j < bursts[b]; j++) {
+						uint16_t bit = start + j;
+
+						if (j == 0 || j == bursts[b] - 1 || (rand() & 1)) {
+							air[bit / 8] ^= 1 << (bit % 8);
+						}
+					}
+					good += burst_receive(mode, elen, lens[l], data, air);
+				}
+				printf("   %8.1f", 100.0 * good / iterations);
+			}
+		}
+		printf("\n");
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench();
+		return failures != 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "burst") == 0) {
+		burst();
+		return 0;
+	}
+
+	make_error_patterns();
+	test_encode();
+	test_correct();
+	test_in_place();
+	test_interleave();
+	test_agree();
+	if (failures != 0) {
+		printf("%u failures\n", failures);
+		return 1;
+	}
+	printf("all golay tests passed\n");
+	return 0;
+}
@@ -0,0 +1,293 @@
+// -*- Mode: C; c-basic-offset: 8; -*-
+//
+// Copyright (c) 2026 SiK developers, All Rights Reserved
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  o Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  o Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in
+//    the documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+///
+/// @file	rs_test.c
+///
+/// Tests and benchmark for the radio Reed-Solomon code, run on the host
+///
+/// With no arguments this checks every block rs_encode() writes is a
+/// codeword, with a bit serial GF(256) multiply rather than the
+/// tables, checks rs_decode() corrects up to RS_PARITY/2 bytes in
+/// error in every block and bursts of up to RS_PARITY/2 bytes per
+/// block, for every message length, and checks it reports blocks with
+/// more errors than that it could not correct, or mis-corrects them
+/// only rarely. It exits non-zero on any failure.
+///
+/// "rs_host bench" times encoding and decoding a full size packet and
+/// prints the bytes on air against golay for a range of payloads.
+///
+
+#include <time.h>
+#include "../../radio/rs.h"
+
+// the largest message radio_transmit_rs() sends, payload and 5 bytes
+// of header
+#define MESSAGE (MAX_PACKET_LENGTH - RS_CODED_BLOCKS(MAX_PACKET_LENGTH) * RS_PARITY)
+
+static unsigned failures;
+
+static void
+check(bool ok, const char *what, uint32_t n)
+{
+	if (!ok) {
+		if (failures < 10) {
+			printf("FAIL: %s %u\n", what, (unsigned)n);
+		}
+		failures++;
+	}
+}
+
+// multiply in GF(256) modulo 0x11D, a bit at a time
+static uint8_t
+mul_serial(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+
+	while (b) {
+		if (b & 1) {
+			r ^= a;
+		}
+		a = (a << 1) ^ ((a & 0x80) ? 0x1D : 0);
+		b >>= 1;
+	}
+	return r;
+}
+
+// true if block b of the n coded bytes is zero at alpha^0..alpha^7
+static bool
+is_codeword(uint8_t n, uint8_t *buf, uint8_t b)
+{
+	uint8_t blocks = RS_CODED_BLOCKS(n);
+	uint8_t m = n - blocks * RS_PARITY;
+	uint8_t i, x = 1, s;
+	int k;
+
+	for (i = 0; i < RS_PARITY; i++) {
+		s = 0;
+		for (k = b; k < m; k += blocks) {
+			s = mul_serial(s, x) ^ buf[k];
+		}
+		for (k = m + (b + blocks - m % blocks) % blocks; k < n; k += blocks) {
+			s = mul_serial(s, x) ^ buf[k];
+		}
+		if (s != 0) {
+			return false;
+		}
+		x = mul_serial(x, 2);
+	}
+	return true;
+}
+
+static void
+fill(uint8_t m, uint8_t *buf)
+{
+	uint8_t k;
+
+	for (k = 0; k < m; k++) {
+		buf[k] = rand();
+	}
+}
+
+static void
+test_encode(void)
+{
+	static uint8_t buf[MAX_PACKET_LENGTH];
+	uint8_t m, n, b;
+
+	for (m = 1; m <= MESSAGE; m++) {
+		fill(m, buf);
+		rs_encode(m, buf);
+		n = m + RS_BLOCKS(m) * RS_PARITY;
+		check(RS_CODED_BLOCKS(n) == RS_BLOCKS(m), "coded blocks", m);
+		for (b = 0; b < RS_BLOCKS(m); b++) {
+			check(is_codeword(n, buf, b), "codeword", m);
+		}
+	}
+}
+
+// up to RS_PARITY/2 random errors in each block, then bursts
+static void
+test_correct(void)
+{
+	static uint8_t buf[MAX_PACKET_LENGTH], good[MAX_PACKET_LENGTH];
+	uint8_t m, n, b, blocks, e, nb, j, k, errs, ret;
+	uint16_t pos, start, i;
+	int trial;
+
+	for (m = 1; m <= MESSAGE; m++) {
+		blocks = RS_BLOCKS(m);
+		n = m + blocks * RS_PARITY;
+		for (trial = 0; trial < 50; trial++) {
+			fill(m, buf);
+			rs_encode(m, buf);
+			memcpy(good, buf, n);
+
+			errs = 0;
+			for (b = 0; b < blocks; b++) {
+				nb = (m - b + blocks - 1) / blocks + RS_PARITY;
+				e = trial % (RS_PARITY/2 + 1);
+				for (j = 0; j < e; j++) {
+					// distinct positions in the block
+					k = (j * 7 + trial) % nb;
+					pos = k < nb - RS_PARITY ? b + k * blocks :
+						m + (b + blocks - m % blocks) % blocks +
+						(k - (nb - RS_PARITY)) * blocks;
+					if (buf[pos] == good[pos]) {
+						errs++;
+					}
+					buf[pos] ^= 1 + rand() % 255;
+					if (buf[pos] == good[pos]) {
+						errs--;
+					}
+				}
+			}
+			ret = rs_decode(n, buf);
+			check(ret == errs && memcmp(buf, good, n) == 0, "correct", m);
+
+			// a burst of RS_PARITY/2 bytes per block
+			start = rand() % (n - blocks * RS_PARITY/2 + 1);
+			for (i = start; i < start + blocks * RS_PARITY/2; i++) {
+				buf[i] ^= 1 + rand() % 255;
+			}
+			ret = rs_decode(n, buf);
+			check(ret != 0xFF && memcmp(buf, good, n) == 0, "burst", m);
+		}
+	}
+}
+
+// RS_PARITY/2 + 1 errors in a block are beyond the code, and should
+// nearly always be reported rather than mis-corrected
+static void
+test_detect(void)
+{
+	static uint8_t buf[MAX_PACKET_LENGTH];
+	uint32_t trials = 0, wrong = 0;
+	uint8_t m, n, j;
+	int trial;
+
+	for (m = 10; m <= MESSAGE; m += 7) {
+		n = m + RS_BLOCKS(m) * RS_PARITY;
+		for (trial = 0; trial < 200; trial++) {
+			fill(m, buf);
+			rs_encode(m, buf);
+			for (j = 0; j < RS_PARITY/2 + 1; j++) {
+				// block 0, distinct positions
+				buf[j * RS_BLOCKS(m)] ^= 1 + rand() % 255;
+			}
+			if (rs_decode(n, buf) != 0xFF) {
+				wrong++;
+			}
+			trials++;
+		}
+	}
+	check(wrong * 100 < trials, "detect", wrong);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+bench(void)
+{
+	static uint8_t buf[MAX_PACKET_LENGTH], coded[MAX_PACKET_LENGTH];
+	static const uint8_t lens[] = { 10, 30, 60, 90, 112, 118, 160, 215 };
+	uint32_t i, iterations = 20000;
+	uint8_t n, b, e, l;
+	double t, enc, dec[2];
+
+	fill(MESSAGE, buf);
+	n = MESSAGE + RS_BLOCKS(MESSAGE) * RS_PARITY;
+
+	t = now();
+	for (i = 0; i < iterations; i++) {
+		rs_encode(MESSAGE, buf);
+	}
+	enc = now() - t;
+	memcpy(coded, buf, n);
+
+	for (e = 0; e < 2; e++) {
+		t = now();
+		for (i = 0; i < iterations; i++) {
+			memcpy(buf, coded, n);
+			if (e) {
+				// the most errors, RS_PARITY/2 in each block
+				for (b = 0; b < RS_BLOCKS(MESSAGE) * RS_PARITY/2; b++) {
+					buf[b * 5] ^= 0x5A;
+				}
+			}
+			check(rs_decode(n, buf) != 0xFF, "bench decode", e);
+		}
+		dec[e] = now() - t;
+	}
+	printf("%u byte message, %u on air\n", MESSAGE, n);
+	printf("encode %.2f us, decode %.2f us clean, %.2f us with %u errors\n",
+	       1e6 * enc / iterations, 1e6 * dec[0] / iterations,
+	       1e6 * dec[1] / iterations, RS_BLOCKS(MESSAGE) * RS_PARITY/2);
+
+	// bytes on air for the data a packet carries, before the
+	// trailer, for golay (header, CRC and data rounded to 3 bytes,
+	// doubled) and for Reed-Solomon (data and 5 header bytes, plus
+	// parity)
+	printf("\n%7s %7s %7s\n", "payload", "golay", "rs");
+	for (l = 0; l < sizeof(lens); l++) {
+		uint8_t m = lens[l] + 5;
+
+		if (lens[l] <= MAX_PACKET_LENGTH / 2 - 6) {
+			printf("%7u %7u", lens[l], 2 * (6 + 3 * ((lens[l] + 2) / 3)));
+		} else {
+			printf("%7u %7s", lens[l], "-");
+		}
+		printf(" %7u\n", m + RS_BLOCKS(m) * RS_PARITY);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench();
+		return failures != 0;
+	}
+
+	test_encode();
+	test_correct();
+	test_detect();
+	if (failures != 0) {
+		printf("%u failures\n", failures);
+		return 1;
+	}
+	printf("all Reed-Solomon tests passed\n");
+	return 0;
+}